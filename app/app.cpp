@@ -7,7 +7,7 @@
 #include <iomanip>
 #include <iostream>
 #include <memory>
-#include <regex>
+#include <variant>
 
 using namespace std::string_literals;
 using namespace Lib;
@@ -17,7 +17,11 @@ namespace po = boost::program_options;
 static const char kFormatHelp[] = R"(
 JSON IO Format Definitions:
   Input ::= {
-    "dataset": Matx | string,   # string for binary output path
+    "dataset": Matx | string,   # string for binary output path, which
+                                # may be quantized by 'quantize'; float64
+                                # binaries are clustered in double; .csv
+                                # or .txt paths are parsed as text, one
+                                # comma-separated point per line
     "cata": string?,            # output binary if exists
     "kmin": number,             # serach range [kmin, kmax]
     "kmax": number,
@@ -37,14 +41,98 @@ JSON IO Format Definitions:
   MseHistory ::=
     [number, number][]          # cata, mse
   Profile ::=
-    [string, number, string?]   # tag, time, info
+    [string, number, string?, Counters?][]
+                                # tag, time, info, hardware counter
+                                # deltas of a scope with --counters
+  Counters ::= {
+    "cycles": int?,
+    "instructions": int?,
+    "llc-misses": int?,
+    "branch-misses": int?,
+    }
 )";
 
+/**
+ * @brief 量化数据集，未使用时为 std::monostate。
+ */
+using QuantDataSet =
+  std::variant<std::monostate, I8DataSet, F16DataSet, BF16DataSet>;
+
+/**
+ * @brief 以实际使用的数据集调用 fn，参数为 DataView、F64DataView 或者量化
+ * 数据集。
+ */
+template<typename Fn>
+void
+visit_dataset(const DataSet& ds,
+              const MappedDataSet& mds,
+              const F64MappedDataSet& fds,
+              const QuantDataSet& qds,
+              Fn&& fn)
+{
+  std::visit(
+    [&](const auto& q) {
+      if constexpr (!std::is_same_v<std::decay_t<decltype(q)>,
+                                    std::monostate>)
+        fn(q);
+      else if (fds)
+        fn(F64DataView(fds));
+      else
+        fn(mds ? DataView(mds) : DataView(ds));
+    },
+    qds);
+}
+
+/**
+ * @brief 按文件头中的数据类型打开二进制数据集。
+ *
+ * @param[in] path 二进制文件路径。
+ * @param[out] mds float 数据集，以内存映射的方式打开。
+ * @param[out] fds double 数据集，以内存映射的方式打开。
+ * @param[out] qds 量化数据集。
+ */
+void
+open_bin(const char* path,
+         MappedDataSet* mds,
+         F64MappedDataSet* fds,
+         QuantDataSet* qds)
+{
+  switch (MatxHeader::peek(path).mDType) {
+    case MatxHeader::DType::kF32:
+      mds->open(path);
+      mds->advise(MappedDataSet::Advice::kSequential);
+      break;
+
+    case MatxHeader::DType::kF64:
+      fds->open(path);
+      fds->advise(F64MappedDataSet::Advice::kSequential);
+      break;
+
+    case MatxHeader::DType::kI8:
+      qds->emplace<I8DataSet>().load_bin(path);
+      break;
+
+    case MatxHeader::DType::kF16:
+      qds->emplace<F16DataSet>().load_bin(path);
+      break;
+
+    case MatxHeader::DType::kBF16:
+      qds->emplace<BF16DataSet>().load_bin(path);
+      break;
+
+    case MatxHeader::DType::kI32:
+      throw err::Lit("integer matx is not a dataset.");
+  }
+}
+
 /**
  * @brief 解析输入文件。
  *
  * @param[in] path JSON 输入文件路径。
- * @param[out] ds 数据集。
+ * @param[out] ds 内联在 JSON 中或者 CSV 文件中的数据集。
+ * @param[out] mds 二进制文件中的数据集，以内存映射的方式打开。
+ * @param[out] fds 二进制文件中的 double 精度数据集，以内存映射的方式打开。
+ * @param[out] qds 二进制文件中的量化数据集。
  * @param[out] cataOut 类别输出路径，如果为空则表示以 JSON 格式输出。
  * @param[out] kmin 最小聚类数。
  * @param[out] kmax 最大聚类数。
@@ -52,35 +140,43 @@ JSON IO Format Definitions:
 void
 parse_input(const char* path,
             DataSet* ds,
+            MappedDataSet* mds,
+            F64MappedDataSet* fds,
+            QuantDataSet* qds,
             std::string* cataOut,
             int* kmin,
             int* kmax)
 {
   bj::value val;
   {
-    bj::parse_options parseOption;
-    parseOption.max_depth = 4;
-    parseOption.allow_comments = true;
-    parseOption.allow_trailing_commas = true;
-    parseOption.allow_invalid_utf8 = false;
-
-    std::ifstream fin(path);
-    val = bj::parse(fin, {}, parseOption);
+    MatxParser parser;
+    parser.mOptions.max_depth = 4;
+    parser.mOptions.allow_comments = true;
+    parser.mOptions.allow_trailing_commas = true;
+    parser.mOptions.allow_invalid_utf8 = false;
+
+    val = parser.load(path, "dataset", ds);
   }
 
   const auto& obj = val.as_object();
 
+  // 内联的数据集已由 parser 直接写入 ds
   const auto& dataset = obj.at("dataset");
-  if (dataset.is_object())
-    *ds = json_to_matx<DataSet::value_type>(dataset);
-  else
-    matx_load_bin(ds, dataset.as_string().c_str());
+  if (!dataset.is_object()) {
+    auto path = dataset.as_string().c_str();
+    if (CsvFile::match(path))
+      CsvFile(path).load(ds);
+    else
+      open_bin(path, mds, fds, qds);
+  }
 
-  std::cout << "DataSet: " << ds->rows() << " rows, " << ds->cols()
-            << " cols\nFirst: ";
-  for (int i = 0; i < ds->rows(); ++i)
-    std::cout << (*ds)(i) << " ";
-  std::cout << std::endl;
+  visit_dataset(*ds, *mds, *fds, *qds, [](const auto& data) {
+    std::cout << "DataSet: " << data.rows() << " rows, " << data.cols()
+              << " cols\nFirst: ";
+    for (int i = 0; i < data.rows(); ++i)
+      std::cout << data.col(0)(i) << " ";
+    std::cout << std::endl;
+  });
 
   auto iter = obj.find("cata");
   if (iter != obj.end())
@@ -101,13 +197,14 @@ parse_input(const char* path,
  * @param[in] mseHist 误差历史。
  * @param[in] prof 用时统计。
  */
+template<typename _Scalar>
 void
 generate_output(const char* path,
                 const Catalog& cata,
                 const std::string& cataOut,
                 int k,
-                DataSet::value_type mse,
-                const MseHistory& mseHist,
+                double mse,
+                const BasicMseHistory<_Scalar>& mseHist,
                 const Profiler& prof)
 {
   bj::object obj;
@@ -128,28 +225,57 @@ generate_output(const char* path,
   fout << obj << std::endl;
 }
 
-static const auto kReportFilter = []() -> std::unique_ptr<std::regex> {
-  const char* re = std::getenv("REPORT_FILTER");
-  if (!re)
-    return nullptr;
-  return std::make_unique<std::regex>(re, std::regex_constants::basic);
-}();
+/**
+ * @brief 以 Trace Event Format 导出用时统计。
+ *
+ * @param[in] path 输出路径，为空则不导出。
+ * @param[in] prof 用时统计。
+ */
+void
+generate_trace(const std::string& path, const Profiler& prof)
+{
+  if (path.empty())
+    return;
+
+  std::ofstream fout(path, std::ios::binary);
+  fout << prof.to_trace() << std::endl;
+}
+
+/**
+ * @brief 实时输出的计时标签，由环境变量 REPORT_FILTER 给出。
+ *
+ * 语法为以 ',' 或 '|'（也可写作 "\|"）分隔的标签，以 '*' 或 ".*" 结尾的
+ * 按前缀匹配，其余按精确匹配，如 REPORT_FILTER="KMeans-iter,LogMeans*"。
+ * 这不再是完整的正则表达式：".*iter"、"[AB]" 等写法会报错而不是被忽略。
+ *
+ * 在第一次使用时构造，使语法错误能在 main 中报告。
+ */
+static const TagFilter&
+report_filter()
+{
+  static const TagFilter kReportFilter(std::getenv("REPORT_FILTER"));
+  return kReportFilter;
+}
 
 template<typename T>
 class Algo : public T
 {
+public:
+  ~Algo() noexcept
+  {
+    if (auto dropped = mSink.dropped())
+      std::cerr << "WARNING! " << dropped
+                << " report lines dropped, the report buffer was full."
+                << std::endl;
+  }
+
+private:
+  /// 计算线程只入队，输出由后台线程完成
+  ReportSink mSink{ std::cout, report_filter() };
+
   void report(Profiler::Entry& entry) noexcept override
   {
-    if (kReportFilter && !std::regex_match(entry.mTag, *kReportFilter))
-      return;
-    // 不知道为什么，std::regex_match 会在KITSUNE数据集上报一个：
-    //   malloc(): unaligned tcache chunk detected
-    // 然后就崩溃了。
-
-    std::cout << (entry.mTime - Profiler::initial()) << " " << entry.mTag;
-    if (entry.mInfo)
-      std::cout << " " << entry.mInfo->info();
-    std::cout << '\n';
+    mSink.push(entry, Profiler::initial());
   }
 };
 
@@ -161,6 +287,10 @@ kmeans(int argc, char* argv[])
     ("help,h", "print help info")                              //
     ("input,i", po::value<std::string>(), "input json path")   //
     ("output,o", po::value<std::string>(), "output json path") //
+    ("trace",
+     po::value<std::string>()->default_value(""),
+     "trace event json path for chrome://tracing or Perfetto") //
+    ("counters,c", "sample hardware counters in profiler scopes") //
     ;
 
   po::positional_options_description pod;
@@ -181,19 +311,28 @@ kmeans(int argc, char* argv[])
 
   auto input = vmap["input"].as<std::string>();
   auto output = vmap["output"].as<std::string>();
+  auto trace = vmap["trace"].as<std::string>();
+  bool counters = vmap.count("counters");
 
   DataSet ds;
+  MappedDataSet mds;
+  F64MappedDataSet fds;
+  QuantDataSet qds;
   std::string cataOut;
   int minK, maxK;
-  parse_input(input.c_str(), &ds, &cataOut, &minK, &maxK);
+  parse_input(input.c_str(), &ds, &mds, &fds, &qds, &cataOut, &minK, &maxK);
 
   Catalog cata;
   double mse;
 
   Algo<KMeans> algo;
-  algo(ds, minK, &cata, &mse);
+  algo.enable_counters(counters);
+  visit_dataset(ds, mds, fds, qds, [&](const auto& data) {
+    algo(data, minK, &cata, &mse);
+  });
 
   generate_output(output.c_str(), cata, cataOut, minK, mse, MseHistory(), algo);
+  generate_trace(trace, algo);
 
   return 0;
 }
@@ -206,6 +345,10 @@ algo_run(int argc, char* argv[], int which)
     ("help,h", "print help info")                              //
     ("input,i", po::value<std::string>(), "input json path")   //
     ("output,o", po::value<std::string>(), "output json path") //
+    ("trace",
+     po::value<std::string>()->default_value(""),
+     "trace event json path for chrome://tracing or Perfetto") //
+    ("counters,c", "sample hardware counters in profiler scopes") //
     ;
 
   po::positional_options_description pod;
@@ -225,44 +368,57 @@ algo_run(int argc, char* argv[], int which)
 
   auto input = vmap["input"].as<std::string>();
   auto output = vmap["output"].as<std::string>();
+  auto trace = vmap["trace"].as<std::string>();
+  bool counters = vmap.count("counters");
 
   DataSet ds;
+  MappedDataSet mds;
+  F64MappedDataSet fds;
+  QuantDataSet qds;
   std::string cataOut;
   int minK, maxK;
-  parse_input(input.c_str(), &ds, &cataOut, &minK, &maxK);
-
-  Catalog cata;
-  MseHistory mseHist;
-  std::size_t ansIndex;
-  Profiler prof;
-
-  switch (which) {
-    case 0: {
-      Algo<Elbow> elbow;
-      elbow(ds, &cata, &mseHist, &ansIndex, minK, maxK);
-      prof = elbow;
-    } break;
-
-    case 1: {
-      Algo<LogMeans> logmeans;
-      logmeans(ds, &cata, &mseHist, &ansIndex, minK, maxK);
-      prof = logmeans;
-    } break;
-
-    case 2: {
-      Algo<LogMeans> logmeans;
-      logmeans.binary_search(ds, &cata, &mseHist, &ansIndex, minK, maxK);
-      prof = logmeans;
-    } break;
-  }
+  parse_input(input.c_str(), &ds, &mds, &fds, &qds, &cataOut, &minK, &maxK);
+
+  visit_dataset(ds, mds, fds, qds, [&](const auto& data) {
+    // 误差历史的精度与数据集相同
+    using Data = std::decay_t<decltype(data)>;
+    BasicMseHistory<typename Data::Scalar> mseHist;
+    Catalog cata;
+    std::size_t ansIndex;
+    Profiler prof;
+
+    switch (which) {
+      case 0: {
+        Algo<Elbow> elbow;
+        elbow.enable_counters(counters);
+        elbow(data, &cata, &mseHist, &ansIndex, minK, maxK);
+        prof = elbow;
+      } break;
+
+      case 1: {
+        Algo<LogMeans> logmeans;
+        logmeans.enable_counters(counters);
+        logmeans(data, &cata, &mseHist, &ansIndex, minK, maxK);
+        prof = logmeans;
+      } break;
+
+      case 2: {
+        Algo<LogMeans> logmeans;
+        logmeans.enable_counters(counters);
+        logmeans.binary_search(data, &cata, &mseHist, &ansIndex, minK, maxK);
+        prof = logmeans;
+      } break;
+    }
 
-  generate_output(output.c_str(),
-                  cata,
-                  cataOut,
-                  mseHist[ansIndex].first,
-                  mseHist[ansIndex].second,
-                  mseHist,
-                  prof);
+    generate_output(output.c_str(),
+                    cata,
+                    cataOut,
+                    mseHist[ansIndex].first,
+                    mseHist[ansIndex].second,
+                    mseHist,
+                    prof);
+    generate_trace(trace, prof);
+  });
 
   return 0;
 }
@@ -285,6 +441,106 @@ logmeans_m(int argc, char* argv[])
   return algo_run(argc, argv, 2);
 }
 
+int
+quantize(int argc, char* argv[])
+{
+  po::options_description od("'quantize' Options");
+  od.add_options()                                                      //
+    ("help,h", "print help info")                                       //
+    ("input,i", po::value<std::string>(), "input binary dataset path")  //
+    ("output,o", po::value<std::string>(), "output binary dataset path") //
+    ("dtype,t",
+     po::value<std::string>()->default_value("i8"),
+     "quantized type: i8, f16 or bf16") //
+    ;
+
+  po::positional_options_description pod;
+  pod.add("input", 1);
+  pod.add("output", 1);
+
+  po::variables_map vmap;
+  po::store(
+    po::command_line_parser(argc, argv).options(od).positional(pod).run(),
+    vmap);
+  po::notify(vmap);
+
+  if (vmap.count("help") || argc == 1) {
+    std::cout << od << std::endl;
+    return 0;
+  }
+
+  auto input = vmap["input"].as<std::string>();
+  auto output = vmap["output"].as<std::string>();
+  auto dtype = vmap["dtype"].as<std::string>();
+
+  // 量化的输入总是 float 精度，double 数据集先转换
+  DataSet ds;
+  if (MatxHeader::peek(input.c_str()).holds<double>()) {
+    F64DataSet f64;
+    matx_load_bin(&f64, input.c_str());
+    ds = f64.cast<DataSet::value_type>();
+  } else
+    matx_load_bin(&ds, input.c_str());
+
+  if (dtype == "i8")
+    I8DataSet(ds).dump_bin(output.c_str());
+  else if (dtype == "f16")
+    F16DataSet(ds).dump_bin(output.c_str());
+  else if (dtype == "bf16")
+    BF16DataSet(ds).dump_bin(output.c_str());
+  else {
+    std::cout << "invalid dtype '" << dtype << "'." << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
+
+int
+import_csv(int argc, char* argv[])
+{
+  po::options_description od("'import-csv' Options");
+  od.add_options()                                                      //
+    ("help,h", "print help info")                                       //
+    ("input,i", po::value<std::string>(), "input CSV path")             //
+    ("output,o", po::value<std::string>(), "output binary dataset path") //
+    ("dtype,t",
+     po::value<std::string>()->default_value("f32"),
+     "element type: f32 or f64") //
+    ;
+
+  po::positional_options_description pod;
+  pod.add("input", 1);
+  pod.add("output", 1);
+
+  po::variables_map vmap;
+  po::store(
+    po::command_line_parser(argc, argv).options(od).positional(pod).run(),
+    vmap);
+  po::notify(vmap);
+
+  if (vmap.count("help") || argc == 1) {
+    std::cout << od << std::endl;
+    return 0;
+  }
+
+  auto input = vmap["input"].as<std::string>();
+  auto output = vmap["output"].as<std::string>();
+  auto dtype = vmap["dtype"].as<std::string>();
+
+  CsvFile csv(input.c_str());
+  if (dtype == "f32")
+    csv.dump_bin<float>(output.c_str());
+  else if (dtype == "f64")
+    csv.dump_bin<double>(output.c_str());
+  else {
+    std::cout << "invalid dtype '" << dtype << "'." << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
+
 int
 example_1(int argc, char* argv[])
 {
@@ -333,6 +589,8 @@ const SubCmdFunc kSubCmdFuncs[] = {
   { "elbow", "Elbow algorithm", &elbow },
   { "logmeans", "Log Means algorithm", &logmeans },
   { "logmeans-m", "Log Means algorithm (modified)", &logmeans_m },
+  { "quantize", "quantize a binary dataset", &quantize },
+  { "import-csv", "convert a CSV file to a binary dataset", &import_csv },
   { "example-1", "print input example 1", &example_1 },
   { "example-2", "print input example 2", &example_2 },
 };
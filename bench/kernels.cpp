@@ -0,0 +1,264 @@
+/**
+ * @brief 这个文件为聚类热点路径的微基准测试，以 JSON 输出各内核的用时
+ */
+
+#include "util.hpp"
+
+#include <Lib/Heap.hpp>
+#include <Lib/kernels.hpp>
+#include <algorithm>
+#include <boost/json.hpp>
+#include <boost/program_options.hpp>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+#include <omp.h>
+#include <random>
+
+using namespace Lib;
+using namespace Lib::kernels;
+
+namespace po = boost::program_options;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+/**
+ * @brief 从数据集中不重复地随机选取 k 个点作为中心点。
+ */
+DataSet
+pick_centers(const DataSet& ds, int k, Random& rand)
+{
+  std::vector<int> index(ds.cols());
+  std::iota(index.begin(), index.end(), 0);
+  std::shuffle(index.begin(), index.end(), rand);
+
+  DataSet centers(ds.rows(), k);
+  for (int i = 0; i < k; ++i)
+    centers.col(i) = ds.col(index[i]);
+  return centers;
+}
+
+/**
+ * @brief 先预热一次，再运行 fn repeat 次，返回各次的纳秒数。
+ */
+template<typename Fn>
+std::vector<double>
+measure(int repeat, Fn&& fn)
+{
+  fn();
+
+  std::vector<double> ns;
+  for (int i = 0; i < repeat; ++i) {
+    auto start = Clock::now();
+    fn();
+    std::chrono::duration<double, std::nano> dura(Clock::now() - start);
+    ns.push_back(dura.count());
+  }
+  return ns;
+}
+
+/**
+ * @brief 一项结果：参数和用时的最小值、中位数与平均值。
+ */
+bj::object
+summarize(const char* bench,
+          int n,
+          int d,
+          int k,
+          int threads,
+          std::vector<double> ns)
+{
+  std::sort(ns.begin(), ns.end());
+
+  bj::object obj;
+  obj["bench"] = bench;
+  obj["n"] = n;
+  obj["d"] = d;
+  obj["k"] = k;
+  obj["threads"] = threads;
+  obj["min_ns"] = ns.front();
+  obj["median_ns"] = ns[ns.size() / 2];
+  obj["mean_ns"] = std::accumulate(ns.begin(), ns.end(), 0.0) / ns.size();
+  return obj;
+}
+
+/**
+ * @brief 以累加结果更新中心点，空类保留原中心点。
+ */
+void
+update_centers(const Accumulator& accum, DataSet& centers)
+{
+  const auto& counts = accum.counts();
+  for (int i = 0; i < centers.cols(); ++i) {
+    if (counts(i) != 0)
+      centers.col(i) = (accum.sums().col(i) / counts(i)).cast<float>();
+  }
+}
+
+/**
+ * @brief 测试分配、更新和完整的一轮 Lloyd 迭代。
+ *
+ * 分配与 KMeans 一样以 dispatch_dims 选择固定维数的内核。
+ */
+void
+bench_kmeans(int n,
+             int d,
+             int k,
+             int threads,
+             const po::variables_map& vmap,
+             bj::array& results)
+{
+  auto repeat = vmap["repeat"].as<int>();
+  auto run = [&](const char* bench, auto&& fn) {
+    results.emplace_back(
+      summarize(bench, n, d, k, threads, measure(repeat, fn)));
+  };
+
+  // 每组参数单独播种，输入与扫描的顺序无关
+  Random rand(vmap["seed"].as<unsigned>());
+  auto ds = make_blobs(n, d, k, 1, rand);
+  auto centers = pick_centers(ds, k, rand);
+  DataView data(ds);
+  Catalog labels(n);
+  Accumulator accum;
+
+  auto assign = [&](const DataSet& centers) {
+    dispatch_dims(
+      data, [&](const auto& view) { assign_lloyd(view, centers, labels); });
+  };
+
+  omp_set_num_threads(threads);
+
+  run("assign-lloyd", [&] { assign(centers); });
+  run("assign-gemm", [&] { assign_gemm(data, centers, labels); });
+
+  assign(centers);
+  run("update", [&] { accum(data, labels, k); });
+
+  // 每轮都从相同的中心点开始，各轮的工作量一致
+  DataSet iter;
+  run("lloyd-iter", [&] {
+    iter = centers;
+    assign(iter);
+    accum(data, labels, k);
+    update_centers(accum, iter);
+  });
+}
+
+/**
+ * @brief 测试 LogMeans 的堆：放入 k 个区间再全部取出。
+ */
+void
+bench_heap(int k, const po::variables_map& vmap, bj::array& results)
+{
+  // 误差随聚类数递减
+  Random rand(vmap["seed"].as<unsigned>());
+  std::uniform_real_distribution<float> uniform(0.5, 1);
+  MseHistory hist;
+  float mse = 1;
+  for (int i = 0; i <= k; ++i)
+    hist.emplace_back(i + 1, mse *= uniform(rand));
+
+  std::vector<HeapEntry> entries;
+  for (int i = 0; i < k; ++i) {
+    auto l = std::uniform_int_distribution<int>(0, k - 1)(rand);
+    auto r = std::uniform_int_distribution<int>(l + 1, k)(rand);
+    entries.push_back({ std::size_t(l), std::size_t(r) });
+  }
+
+  auto ns = measure(vmap["repeat"].as<int>(), [&] {
+    Heap<MseHistory> heap(hist);
+    for (auto&& i : entries)
+      heap.heap_push(i);
+    while (heap.size() > 1)
+      heap.heap_pop();
+  });
+  results.emplace_back(summarize("heap-push-pop", 0, 0, k, 1, ns));
+}
+
+} // namespace
+
+int
+main(int argc, char* argv[])
+try {
+  po::options_description od("Kernel Benchmark Options");
+  od.add_options()                //
+    ("help,h", "print help info") //
+    ("n",
+     po::value<std::vector<int>>()->multitoken()->default_value(
+       { 100000 }, "100000"),
+     "numbers of points") //
+    ("d",
+     po::value<std::vector<int>>()->multitoken()->default_value(
+       { 2, 16, 64 }, "2 16 64"),
+     "numbers of dimensions") //
+    ("k",
+     po::value<std::vector<int>>()->multitoken()->default_value(
+       { 16, 128 }, "16 128"),
+     "numbers of clusters") //
+    ("threads,t",
+     po::value<std::vector<int>>()->multitoken(),
+     "numbers of threads, default 1 and the maximum") //
+    ("seed,s", po::value<unsigned>()->default_value(1), "random seed") //
+    ("repeat,r",
+     po::value<int>()->default_value(5),
+     "timed runs per kernel after one warm-up run") //
+    ("output,o",
+     po::value<std::string>(),
+     "output json path, default stdout") //
+    ;
+
+  po::variables_map vmap;
+  po::store(po::parse_command_line(argc, argv, od), vmap);
+  po::notify(vmap);
+
+  if (vmap.count("help")) {
+    std::cout << od << std::endl;
+    return 0;
+  }
+
+  if (vmap["repeat"].as<int>() < 1) {
+    std::cout << "repeat must be positive." << std::endl;
+    return 1;
+  }
+
+  std::vector<int> threads{ 1, omp_get_max_threads() };
+  if (vmap.count("threads"))
+    threads = vmap["threads"].as<std::vector<int>>();
+  threads.erase(std::unique(threads.begin(), threads.end()), threads.end());
+
+  bj::array results;
+  for (auto n : vmap["n"].as<std::vector<int>>()) {
+    for (auto d : vmap["d"].as<std::vector<int>>()) {
+      for (auto k : vmap["k"].as<std::vector<int>>()) {
+        if (k > n)
+          continue;
+        for (auto t : threads)
+          bench_kmeans(n, d, k, t, vmap, results);
+      }
+    }
+  }
+  for (auto k : vmap["k"].as<std::vector<int>>())
+    bench_heap(k, vmap, results);
+
+  bj::object obj;
+  obj["seed"] = vmap["seed"].as<unsigned>();
+  obj["repeat"] = vmap["repeat"].as<int>();
+  obj["results"] = std::move(results);
+
+  if (vmap.count("output")) {
+    std::ofstream fout(vmap["output"].as<std::string>(), std::ios::binary);
+    fout << obj << std::endl;
+  } else
+    std::cout << obj << std::endl;
+
+  return 0;
+}
+
+catch (std::exception& e) {
+  std::cerr << "\nERROR! " << e.what() << std::endl;
+  return -2;
+}
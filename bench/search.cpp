@@ -0,0 +1,312 @@
+/**
+ * @brief 这个文件为 elbow、logmeans 与 logmeans-m 三种搜索策略的端到端伸缩性
+ * 测试，在给定真实聚类数的合成数据上比较用时、KMeans 次数与结果
+ */
+
+#include "util.hpp"
+
+#include <Lib/hpp>
+#include <atomic>
+#include <boost/json.hpp>
+#include <boost/program_options.hpp>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <omp.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace Lib;
+
+namespace po = boost::program_options;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+/**
+ * @brief 一次搜索的结果，由子进程经管道传回。
+ */
+struct Result
+{
+  double mSeconds;     ///< 搜索用时，不含生成数据
+  std::int64_t mRuns;  ///< KMeans 的调用次数
+  std::int64_t mIters; ///< Lloyd 迭代的总轮数
+  int mK;              ///< 搜索得到的聚类数
+};
+
+/**
+ * @brief 统计 KMeans 调用次数和迭代轮数的搜索算法。
+ *
+ * 收敛的那一轮不产生 KMeans-iter 记录，因此总轮数为记录数加调用次数。
+ */
+template<typename T>
+class Counted : public T
+{
+public:
+  std::atomic<std::int64_t> mRuns{ 0 }, mIters{ 0 };
+
+private:
+  void report(Profiler::Entry& entry) noexcept override
+  {
+    if (entry.mInfo == &Profiler::Scope::gEnterInfo &&
+        !std::strcmp(entry.mTag, "KMeans"))
+      mRuns.fetch_add(1, std::memory_order_relaxed);
+    else if (!std::strcmp(entry.mTag, "KMeans-iter"))
+      mIters.fetch_add(1, std::memory_order_relaxed);
+  }
+};
+
+/**
+ * @brief 在 threads 个线程上对 n 个点的合成数据运行一次搜索。
+ */
+Result
+search(const std::string& algo,
+       int n,
+       int threads,
+       const po::variables_map& vmap)
+{
+  auto seed = vmap["seed"].as<unsigned>();
+  Random rand(seed);
+  auto ds = make_blobs(n,
+                       vmap["d"].as<int>(),
+                       vmap["k"].as<int>(),
+                       vmap["sigma"].as<float>(),
+                       rand);
+  auto kmin = vmap["kmin"].as<int>(), kmax = vmap["kmax"].as<int>();
+  omp_set_num_threads(threads);
+
+  Catalog cata;
+  MseHistory mseHist;
+  std::size_t ansIndex;
+  Result ret;
+
+  // KMeans 也使用固定的种子，各次运行的初始中心点相同
+  auto start = [&](auto& counted) {
+    counted.get_kmeans().mSeed = seed;
+    return Clock::now();
+  };
+  auto finish = [&](auto& counted, Clock::time_point begin) {
+    std::chrono::duration<double> dura(Clock::now() - begin);
+    ret.mSeconds = dura.count();
+    ret.mRuns = counted.mRuns;
+    ret.mIters = counted.mIters + counted.mRuns;
+    ret.mK = mseHist[ansIndex].first;
+  };
+
+  if (algo == "elbow") {
+    Counted<Elbow> elbow;
+    auto begin = start(elbow);
+    elbow(ds, &cata, &mseHist, &ansIndex, kmin, kmax);
+    finish(elbow, begin);
+  } else if (algo == "logmeans") {
+    Counted<LogMeans> logmeans;
+    auto begin = start(logmeans);
+    logmeans(ds, &cata, &mseHist, &ansIndex, kmin, kmax);
+    finish(logmeans, begin);
+  } else if (algo == "logmeans-m") {
+    Counted<LogMeans> logmeans;
+    auto begin = start(logmeans);
+    logmeans.binary_search(ds, &cata, &mseHist, &ansIndex, kmin, kmax);
+    finish(logmeans, begin);
+  } else
+    throw err::Str("invalid algorithm '" + algo + "'.");
+
+  return ret;
+}
+
+/**
+ * @brief 在子进程中运行 search，由 wait4 取得子进程的峰值常驻内存。
+ *
+ * 父进程不进入 OpenMP 并行区，fork 之后子进程的 OpenMP 运行时是干净的。
+ */
+bj::object
+measure(const std::string& algo,
+        int n,
+        int threads,
+        const po::variables_map& vmap)
+{
+  int fds[2];
+  if (pipe(fds) == -1)
+    throw err::Errno(errno);
+
+  std::cout.flush();
+  auto pid = fork();
+  if (pid == -1)
+    throw err::Errno(errno);
+
+  if (pid == 0) {
+    close(fds[0]);
+    Result result;
+    try {
+      result = search(algo, n, threads, vmap);
+    } catch (std::exception& e) {
+      std::cerr << "\nERROR! " << e.what() << std::endl;
+      _exit(1);
+    }
+    auto bytes = write(fds[1], &result, sizeof(result));
+    _exit(bytes == sizeof(result) ? 0 : 1);
+  }
+
+  close(fds[1]);
+  Result result;
+  auto bytes = read(fds[0], &result, sizeof(result));
+  close(fds[0]);
+
+  int status;
+  rusage usage;
+  if (wait4(pid, &status, 0, &usage) == -1)
+    throw err::Errno(errno);
+  if (bytes != sizeof(result) || !WIFEXITED(status) ||
+      WEXITSTATUS(status) != 0)
+    throw err::Str("search '" + algo + "' failed.");
+
+  auto k = vmap["k"].as<int>();
+  bj::object obj;
+  obj["algo"] = algo;
+  obj["n"] = n;
+  obj["threads"] = threads;
+  obj["seconds"] = result.mSeconds;
+  obj["kmeans_runs"] = result.mRuns;
+  obj["lloyd_iters"] = result.mIters;
+  obj["peak_rss_kb"] = std::int64_t(usage.ru_maxrss);
+  obj["found_k"] = result.mK;
+  obj["found"] = result.mK == k;
+  return obj;
+}
+
+/**
+ * @brief 打印伸缩性表格，加速比与效率相对于每种算法线程数最少的一行。
+ *
+ * @param weak 是否为弱伸缩，此时效率为用时之比，否则为加速比除以线程倍数
+ */
+void
+print_table(const char* title, const bj::array& rows, bool weak)
+{
+  std::cout << '\n'
+            << title << '\n'
+            << std::left << std::setw(12) << "algo" << std::right
+            << std::setw(8) << "threads" << std::setw(12) << "n"
+            << std::setw(10) << "time(s)" << std::setw(9) << "speedup"
+            << std::setw(8) << "eff" << std::setw(8) << "kmeans"
+            << std::setw(8) << "iters" << std::setw(10) << "rss(MB)"
+            << std::setw(8) << "k" << '\n';
+
+  const bj::object* base = nullptr;
+  for (auto&& i : rows) {
+    const auto& row = i.as_object();
+    if (!base || row.at("algo") != base->at("algo"))
+      base = &row;
+
+    auto seconds = row.at("seconds").as_double();
+    auto threads = row.at("threads").to_number<double>();
+    auto speedup = base->at("seconds").as_double() / seconds;
+    auto scale = threads / base->at("threads").to_number<double>();
+    auto eff = weak ? speedup : speedup / scale;
+
+    std::cout << std::left << std::setw(12)
+              << row.at("algo").as_string().c_str() << std::right
+              << std::setw(8) << row.at("threads").to_number<int>()
+              << std::setw(12) << row.at("n").to_number<int>() << std::fixed
+              << std::setprecision(3) << std::setw(10) << seconds
+              << std::setprecision(2) << std::setw(9) << speedup
+              << std::setw(8) << eff << std::setw(8)
+              << row.at("kmeans_runs").to_number<int>() << std::setw(8)
+              << row.at("lloyd_iters").to_number<int>() << std::setw(10)
+              << row.at("peak_rss_kb").to_number<double>() / 1024
+              << std::setw(7) << row.at("found_k").to_number<int>()
+              << (row.at("found").as_bool() ? ' ' : '*') << '\n';
+  }
+  std::cout << "(* the true k was not found)" << std::endl;
+}
+
+} // namespace
+
+int
+main(int argc, char* argv[])
+try {
+  std::vector<int> threads;
+  for (int i = 1; i < omp_get_max_threads(); i <<= 1)
+    threads.push_back(i);
+  threads.push_back(omp_get_max_threads());
+
+  po::options_description od("Search Scaling Benchmark Options");
+  od.add_options()                //
+    ("help,h", "print help info") //
+    ("algo,a",
+     po::value<std::vector<std::string>>()->multitoken()->default_value(
+       { "elbow", "logmeans", "logmeans-m" }, "elbow logmeans logmeans-m"),
+     "search strategies") //
+    ("n",
+     po::value<int>()->default_value(200000),
+     "number of points for strong scaling") //
+    ("weak-n",
+     po::value<int>()->default_value(50000),
+     "number of points per thread for weak scaling") //
+    ("d", po::value<int>()->default_value(8), "number of dimensions") //
+    ("k", po::value<int>()->default_value(16), "true number of clusters") //
+    ("kmin", po::value<int>()->default_value(2), "lower bound of search") //
+    ("kmax", po::value<int>()->default_value(64), "upper bound of search") //
+    ("sigma",
+     po::value<float>()->default_value(0.5, "0.5"),
+     "standard deviation of each cluster") //
+    ("threads,t",
+     po::value<std::vector<int>>()->multitoken(),
+     "numbers of threads, default powers of 2 and the maximum") //
+    ("seed,s", po::value<unsigned>()->default_value(1), "random seed") //
+    ("output,o", po::value<std::string>(), "output json path") //
+    ;
+
+  po::variables_map vmap;
+  po::store(po::parse_command_line(argc, argv, od), vmap);
+  po::notify(vmap);
+
+  if (vmap.count("help")) {
+    std::cout << od << std::endl;
+    return 0;
+  }
+
+  if (vmap.count("threads"))
+    threads = vmap["threads"].as<std::vector<int>>();
+
+  bj::array strong, weak;
+  for (auto&& algo : vmap["algo"].as<std::vector<std::string>>()) {
+    for (auto t : threads)
+      strong.emplace_back(measure(algo, vmap["n"].as<int>(), t, vmap));
+    for (auto t : threads)
+      weak.emplace_back(measure(algo, vmap["weak-n"].as<int>() * t, t, vmap));
+  }
+
+  print_table("Strong scaling", strong, false);
+  print_table("Weak scaling", weak, true);
+
+  if (vmap.count("output")) {
+    bj::object obj;
+    obj["d"] = vmap["d"].as<int>();
+    obj["k"] = vmap["k"].as<int>();
+    obj["kmin"] = vmap["kmin"].as<int>();
+    obj["kmax"] = vmap["kmax"].as<int>();
+    obj["sigma"] = vmap["sigma"].as<float>();
+    obj["seed"] = vmap["seed"].as<unsigned>();
+    obj["strong"] = std::move(strong);
+    obj["weak"] = std::move(weak);
+
+    std::ofstream fout(vmap["output"].as<std::string>(), std::ios::binary);
+    fout << obj << std::endl;
+  }
+
+  return 0;
+}
+
+catch (Lib::Err& e) {
+  std::cerr << "\nERROR! " << e.what() << "\n" << e.info() << std::endl;
+  return -3;
+}
+
+catch (std::exception& e) {
+  std::cerr << "\nERROR! " << e.what() << std::endl;
+  return -2;
+}
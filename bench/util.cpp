@@ -0,0 +1,20 @@
+#include "util.hpp"
+
+Lib::DataSet
+make_blobs(int n, int d, int k, float sigma, Random& rand)
+{
+  std::uniform_real_distribution<float> uniform(-10, 10);
+  std::normal_distribution<float> normal(0, sigma);
+
+  Lib::DataSet means(d, k);
+  for (Eigen::Index i = 0; i < means.size(); ++i)
+    means.data()[i] = uniform(rand);
+
+  Lib::DataSet ds(d, n);
+  for (int j = 0; j < n; ++j) {
+    auto c = j % k;
+    for (int i = 0; i < d; ++i)
+      ds(i, j) = means(i, c) + normal(rand);
+  }
+  return ds;
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <Lib/lib.hpp>
+#include <random>
+
+/**
+ * @brief 基准测试的随机数引擎，以给定的种子生成可复现的输入。
+ */
+using Random = std::mt19937_64;
+
+/**
+ * @brief 生成 k 个各向同性高斯簇组成的 d 维数据集，第 j 个点属于第 j % k
+ * 簇。簇中心在 [-10, 10]^d 中均匀分布，标准差为 sigma。
+ */
+Lib::DataSet
+make_blobs(int n, int d, int k, float sigma, Random& rand);
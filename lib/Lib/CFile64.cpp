@@ -1,5 +1,142 @@
 #include "CFile64.hpp"
+#include <algorithm>
+#include <cstring>
+
+#ifdef _WIN32
+#include <io.h>
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 namespace Lib {
 
+namespace {
+
+#ifdef _WIN32
+
+constexpr std::int64_t kMaxIO = 1 << 30; ///< 单次 ReadFile/WriteFile 的上限
+
+HANDLE
+handle_of(std::FILE* ptr)
+{
+  return reinterpret_cast<HANDLE>(_get_osfhandle(_fileno(ptr)));
+}
+
+OVERLAPPED
+overlapped(std::int64_t addr)
+{
+  OVERLAPPED ov{};
+  ov.Offset = static_cast<DWORD>(addr);
+  ov.OffsetHigh = static_cast<DWORD>(addr >> 32);
+  return ov;
+}
+
+#endif
+
+} // namespace
+
+CFile64
+CFile64::open_direct(const char* path, const char* mode) noexcept(false)
+{
+#if defined(_WIN32) || !defined(O_DIRECT)
+  return CFile64(path, mode);
+#else
+  int flags = std::strchr(mode, '+') ? O_RDWR
+              : mode[0] == 'r'       ? O_RDONLY
+                                     : O_WRONLY;
+  if (mode[0] == 'w')
+    flags |= O_CREAT | O_TRUNC;
+  else if (mode[0] == 'a')
+    flags |= O_CREAT | O_APPEND;
+
+  // tmpfs 等文件系统不支持 O_DIRECT，此时退化为普通打开
+  int fd = ::open(path, flags | O_DIRECT, 0666);
+  if (fd == -1 && errno == EINVAL)
+    fd = ::open(path, flags, 0666);
+  if (fd == -1)
+    throw err::Errno(errno);
+
+  auto* ptr = fdopen(fd, mode);
+  if (ptr == nullptr) {
+    auto code = errno;
+    ::close(fd);
+    throw err::Errno(code);
+  }
+  return CFile64(ptr);
+#endif
+}
+
+std::int64_t
+CFile64::pread(void* buffer, std::int64_t bytes, std::int64_t addr) const
+  noexcept(false)
+{
+  auto* p = static_cast<char*>(buffer);
+  std::int64_t done = 0;
+  while (done < bytes) {
+#ifdef _WIN32
+    auto ov = overlapped(addr + done);
+    DWORD n;
+    if (!ReadFile(handle_of(mPtr),
+                  p + done,
+                  static_cast<DWORD>(std::min(bytes - done, kMaxIO)),
+                  &n,
+                  &ov)) {
+      auto code = GetLastError();
+      if (code == ERROR_HANDLE_EOF)
+        break;
+      throw err::Win32(code);
+    }
+#else
+    auto n = ::pread(fileno(mPtr), p + done, bytes - done, addr + done);
+    if (n == -1) {
+      if (errno == EINTR)
+        continue;
+      throw err::Errno(errno);
+    }
+#endif
+    if (n == 0)
+      break;
+    done += n;
+  }
+  return done;
+}
+
+void
+CFile64::pwrite(const void* buffer, std::int64_t bytes, std::int64_t addr) const
+  noexcept(false)
+{
+  auto* p = static_cast<const char*>(buffer);
+  std::int64_t done = 0;
+  while (done < bytes) {
+#ifdef _WIN32
+    auto ov = overlapped(addr + done);
+    DWORD n;
+    if (!WriteFile(handle_of(mPtr),
+                   p + done,
+                   static_cast<DWORD>(std::min(bytes - done, kMaxIO)),
+                   &n,
+                   &ov))
+      throw err::Win32(GetLastError());
+#else
+    auto n = ::pwrite(fileno(mPtr), p + done, bytes - done, addr + done);
+    if (n == -1) {
+      if (errno == EINTR)
+        continue;
+      throw err::Errno(errno);
+    }
+#endif
+    done += n;
+  }
+}
+
+void
+CFile64::readahead(std::int64_t addr, std::int64_t bytes) const noexcept
+{
+#if !defined(_WIN32) && defined(POSIX_FADV_WILLNEED)
+  posix_fadvise(fileno(mPtr), addr, bytes, POSIX_FADV_WILLNEED);
+#endif
+}
+
 } // namespace Lib
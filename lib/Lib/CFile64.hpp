@@ -29,7 +29,10 @@ public:
   class Closers;
 
 public:
-  std::FILE* mPtr;
+  static constexpr std::int64_t kDirectAlign = 4096; ///< 直接 I/O 的对齐
+
+public:
+  std::FILE* mPtr{ nullptr };
 
   CFile64() noexcept = default;
 
@@ -57,6 +60,16 @@ public:
       throw err::Errno(errno);
   }
 
+  /**
+   * @brief 以绕过页缓存的直接 I/O 方式打开文件，文件系统不支持或非 Linux
+   * 平台上退化为普通打开。
+   *
+   * 直接 I/O 时只能使用 pread 和 pwrite，且偏移、长度和缓冲区地址都须对齐到
+   * kDirectAlign。
+   */
+  static CFile64 open_direct(const char* path,
+                             const char* mode) noexcept(false);
+
   operator bool() const noexcept { return mPtr != nullptr; }
 
   operator std::FILE*() const noexcept { return mPtr; }
@@ -140,6 +153,30 @@ public:
              std::int64_t count,
              std::int64_t addr) const noexcept(false);
 
+  /**
+   * @brief 从偏移 addr 处读取 bytes 字节。不经过 std::FILE 的缓冲，可以在
+   * 多个线程中对同一文件并发调用；与缓冲的读写混用前应先 flush。
+   *
+   * POSIX 上不移动文件位置。Windows 上同步句柄的 ReadFile/WriteFile 即使
+   * 给出偏移也会移动文件位置，并发调用时无法恢复，因此之后要使用缓冲的
+   * 读写须先 seek。
+   *
+   * @return 实际读取的字节数，只在到达文件末尾时少于 bytes
+   */
+  std::int64_t pread(void* buffer, std::int64_t bytes, std::int64_t addr) const
+    noexcept(false);
+
+  /**
+   * @brief 将 bytes 字节写入偏移 addr 处，语义同 pread。
+   */
+  void pwrite(const void* buffer, std::int64_t bytes, std::int64_t addr) const
+    noexcept(false);
+
+  /**
+   * @brief 提示操作系统开始预读 [addr, addr + bytes)，不支持时忽略。
+   */
+  void readahead(std::int64_t addr, std::int64_t bytes) const noexcept;
+
   void flush() const noexcept(false)
   {
     if (std::fflush(mPtr))
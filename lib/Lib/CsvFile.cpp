@@ -0,0 +1,265 @@
+#include "CsvFile.hpp"
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <numeric>
+
+namespace Lib {
+
+namespace {
+
+bool
+is_blank(char c)
+{
+  return c == ' ' || c == '\t' || c == '\r';
+}
+
+/**
+ * @brief 从 p 开始的一行的末尾，即 '\n' 或 end 的位置。
+ */
+const char*
+line_end(const char* p, const char* end)
+{
+  auto* eol = static_cast<const char*>(std::memchr(p, '\n', end - p));
+  return eol ? eol : end;
+}
+
+bool
+is_blank_line(const char* p, const char* eol)
+{
+  return std::all_of(p, eol, is_blank);
+}
+
+/**
+ * @brief 数出 [begin, end) 中的非空行数。
+ */
+std::int64_t
+count_lines(const char* begin, const char* end)
+{
+  std::int64_t n = 0;
+  for (auto* p = begin; p != end;) {
+    auto* eol = line_end(p, end);
+    n += !is_blank_line(p, eol);
+    p = eol == end ? end : eol + 1;
+  }
+  return n;
+}
+
+/**
+ * @brief 解析 [p, end) 开头的一个数，允许前导的 '+'，超出 _Scalar 范围的数先
+ * 按 double 解析再转换。
+ *
+ * @return 数之后的位置，格式错误时为空
+ */
+template<typename _Scalar>
+const char*
+parse_number(const char* p, const char* end, _Scalar* out)
+{
+  if (p != end && *p == '+')
+    ++p;
+  auto ret = std::from_chars(p, end, *out);
+  if (ret.ec == std::errc::result_out_of_range) {
+    double d;
+    ret = std::from_chars(p, end, d);
+    *out = static_cast<_Scalar>(d);
+  }
+  return ret.ec == std::errc() && ret.ptr != p ? ret.ptr : nullptr;
+}
+
+/**
+ * @brief 解析 [begin, end) 中的非空行，每行 dims 个数依次写入 out。
+ *
+ * @return 格式是否正确
+ */
+template<typename _Scalar>
+bool
+parse_lines(const char* begin,
+            const char* end,
+            Eigen::Index dims,
+            _Scalar* out)
+{
+  for (auto* p = begin; p != end;) {
+    auto* eol = line_end(p, end);
+    if (!is_blank_line(p, eol)) {
+      for (Eigen::Index i = 0; i < dims; ++i) {
+        if (i != 0) {
+          if (p == eol || *p != ',')
+            return false;
+          ++p;
+        }
+        p = std::find_if_not(p, eol, is_blank);
+        if ((p = parse_number(p, eol, out++)) == nullptr)
+          return false;
+        p = std::find_if_not(p, eol, is_blank);
+      }
+      if (p != eol)
+        return false;
+    }
+    p = eol == end ? end : eol + 1;
+  }
+  return true;
+}
+
+} // namespace
+
+bool
+CsvFile::match(const char* path) noexcept
+{
+  auto len = std::strlen(path);
+  return len >= 4 && (!std::strcmp(path + len - 4, ".csv") ||
+                      !std::strcmp(path + len - 4, ".txt"));
+}
+
+void
+CsvFile::open(const char* path) noexcept(false)
+{
+  mFile.open(path);
+  mDims = 0;
+
+  auto *p = mFile.data(), *end = p + mFile.size();
+  while (p != end) {
+    auto* eol = line_end(p, end);
+    if (!is_blank_line(p, eol)) {
+      mDims = std::count(p, eol, ',') + 1;
+      break;
+    }
+    p = eol == end ? end : eol + 1;
+  }
+  if (mDims == 0)
+    throw err::Lit("empty CSV file.");
+}
+
+std::vector<const char*>
+CsvFile::chunks() const
+{
+  auto size = mFile.size();
+  auto *begin = mFile.data(), *end = begin + size;
+  auto n = std::max<std::size_t>(4 * omp_get_max_threads(),
+                                 size / mChunkBytes + 1);
+
+  // 每个切分点推迟到下一行的行首
+  std::vector<const char*> cuts{ begin };
+  for (std::size_t i = 1; i < n; ++i) {
+    auto* p = begin + size * i / n;
+    if (p <= cuts.back())
+      continue;
+    if ((p = line_end(p - 1, end)) == end || ++p == end)
+      break;
+    cuts.push_back(p);
+  }
+  cuts.push_back(end);
+  return cuts;
+}
+
+template<typename _Scalar>
+void
+CsvFile::load(BasicDataSet<_Scalar>* matx) const noexcept(false)
+{
+  auto cuts = chunks();
+  int n = cuts.size() - 1;
+
+  std::vector<std::int64_t> firsts(n + 1, 0);
+#pragma omp parallel for schedule(dynamic)
+  for (int i = 0; i < n; ++i)
+    firsts[i + 1] = count_lines(cuts[i], cuts[i + 1]);
+  std::partial_sum(firsts.begin(), firsts.end(), firsts.begin());
+
+  matx->resize(mDims, firsts[n]);
+  bool bad = false;
+#pragma omp parallel for schedule(dynamic) reduction(|| : bad)
+  for (int i = 0; i < n; ++i) {
+    auto* out = matx->data() + mDims * firsts[i];
+    bad = !parse_lines(cuts[i], cuts[i + 1], mDims, out) || bad;
+  }
+
+  if (bad)
+    throw err::Lit("invalid line in CSV file.");
+}
+
+template<typename _Scalar>
+void
+CsvFile::dump_bin(const char* path) const noexcept(false)
+{
+  MatxHeader header;
+  header.mDType = MatxHeader::dtype_of<_Scalar>();
+  header.mRows = mDims;
+
+  auto cuts = chunks();
+  int n = cuts.size() - 1;
+  std::int64_t cols = 0;
+  bool bad = false;
+  std::exception_ptr error;
+  auto fail = [&error]() {
+#pragma omp critical(csv_dump_bin)
+    if (!error)
+      error = std::current_exception();
+  };
+
+  {
+    CFile64 file(path, "wb");
+    CFile64::Closer closer(file);
+
+#pragma omp parallel reduction(|| : bad)
+    {
+      std::vector<_Scalar> buf;
+
+#pragma omp for ordered schedule(dynamic)
+      for (int i = 0; i < n; ++i) {
+        bool ok = false;
+        try {
+          buf.resize(mDims * count_lines(cuts[i], cuts[i + 1]));
+          ok = parse_lines(cuts[i], cuts[i + 1], mDims, buf.data());
+        } catch (...) {
+          fail();
+        }
+        bad = !ok || bad;
+
+        // 只有领取写入位置这一步按段的顺序进行，每段都必须经过一次
+        std::int64_t first;
+#pragma omp ordered
+        {
+          first = cols;
+          cols += buf.size() / mDims;
+        }
+
+        if (ok) {
+          try {
+            file.pwrite(buf.data(),
+                        sizeof(_Scalar) * buf.size(),
+                        header.offset() + sizeof(_Scalar) * mDims * first);
+          } catch (...) {
+            fail();
+          }
+        }
+      }
+    }
+
+    // 列数确定后才写入文件头
+    if (!bad && !error) {
+      try {
+        header.mCols = cols;
+        file.pwrite(&header, sizeof(header), 0);
+        file.trunc(header.offset() + sizeof(_Scalar) * mDims * cols);
+      } catch (...) {
+        error = std::current_exception();
+      }
+    }
+  }
+
+  // 失败时不留下没有文件头的输出
+  if (error || bad)
+    std::remove(path);
+  if (error)
+    std::rethrow_exception(error);
+  if (bad)
+    throw err::Lit("invalid line in CSV file.");
+}
+
+template void CsvFile::load(DataSet*) const;
+template void CsvFile::load(F64DataSet*) const;
+template void CsvFile::dump_bin<float>(const char*) const;
+template void CsvFile::dump_bin<double>(const char*) const;
+
+} // namespace Lib
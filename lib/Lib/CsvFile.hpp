@@ -0,0 +1,72 @@
+#pragma once
+
+#include "MappedFile.hpp"
+#include "lib.hpp"
+
+namespace Lib {
+
+/**
+ * @brief 内存映射的 CSV 文本数据集。
+ *
+ * 每行一个点，各坐标以逗号分隔，维数由第一个非空行确定，空行被忽略。文件按
+ * 字节数切为若干从行首开始的段，由多个线程各自用 std::from_chars 解析，结果
+ * 按列存储，与二进制格式（见 matx_dump_bin）一致。
+ */
+class CsvFile
+{
+public:
+  std::size_t mChunkBytes{ 64 << 20 }; ///< 每段文本的字节数上限
+
+public:
+  CsvFile() noexcept = default;
+
+  /**
+   * @param path 文件路径
+   */
+  explicit CsvFile(const char* path) noexcept(false) { open(path); }
+
+public:
+  /**
+   * @brief 路径的扩展名是否为 .csv 或 .txt。
+   */
+  static bool match(const char* path) noexcept;
+
+  /**
+   * @brief 打开并映射文件，读取第一个非空行以确定维数。
+   */
+  void open(const char* path) noexcept(false);
+
+  /**
+   * @brief 每个点的维数，即二进制格式的行数。
+   */
+  Eigen::Index dims() const noexcept { return mDims; }
+
+  /**
+   * @brief 解析全部数据到内存中。
+   *
+   * 先并行数出各段的行数，矩阵按总数一次分配，再由各段直接写入对应的列。
+   */
+  template<typename _Scalar>
+  void load(BasicDataSet<_Scalar>* matx) const noexcept(false);
+
+  /**
+   * @brief 转换为二进制文件，内存中只保留各线程正在处理的段。
+   *
+   * 各线程将一段解析到私有缓冲区，按段的顺序领取写入位置后，在同一文件上以
+   * pwrite 写入。
+   */
+  template<typename _Scalar>
+  void dump_bin(const char* path) const noexcept(false);
+
+private:
+  MappedFile mFile;
+  Eigen::Index mDims{ 0 };
+
+private:
+  /**
+   * @brief 将文件切为从行首开始的段，返回各段的起点与文件末尾。
+   */
+  std::vector<const char*> chunks() const;
+};
+
+} // namespace Lib
@@ -1,34 +1,89 @@
 #include "Elbow.hpp"
+#include <map>
+#include <mutex>
+#include <omp.h>
 
 namespace Lib {
 
 void
-Elbow::operator()(const DataSet& data,
+Elbow::operator()(const DataView& data,
                   Catalog* cata,
                   MseHistory* mseHist,
                   std::size_t* ansIndex,
                   int minK,
                   int maxK)
+{
+  run(data, cata, mseHist, ansIndex, minK, maxK);
+}
+
+void
+Elbow::operator()(const F64DataView& data,
+                  Catalog* cata,
+                  F64MseHistory* mseHist,
+                  std::size_t* ansIndex,
+                  int minK,
+                  int maxK)
+{
+  run(data, cata, mseHist, ansIndex, minK, maxK);
+}
+
+template<typename Code>
+void
+Elbow::operator()(const Quantized<Code>& data,
+                  Catalog* cata,
+                  MseHistory* mseHist,
+                  std::size_t* ansIndex,
+                  int minK,
+                  int maxK)
+{
+  run(data, cata, mseHist, ansIndex, minK, maxK);
+}
+
+template<typename Data>
+void
+Elbow::run(const Data& data,
+           Catalog* cata,
+           History<Data>* mseHist,
+           std::size_t* ansIndex,
+           int minK,
+           int maxK)
 {
   Profiler::Scope scopeProf(*this, "Elbow");
 
   mseHist->clear();
+  mWarm.clear();
 
-  int dims = data.rows();
-  int dataNums = data.cols();
+  // 数据量小时单个 KMeans 难以用满所有线程，改为各聚类数之间并行
+  if (omp_get_max_threads() > 1 && data.cols() < mTaskThreshold &&
+      maxK > minK)
+    sweep_tasks(data, cata, mseHist, ansIndex, minK, maxK);
+  else
+    sweep(data, cata, mseHist, ansIndex, minK, maxK);
+}
+
+template<typename Data>
+void
+Elbow::sweep(const Data& data,
+             Catalog* cata,
+             History<Data>* mseHist,
+             std::size_t* ansIndex,
+             int minK,
+             int maxK)
+{
+  using Scalar = typename Data::Scalar;
 
-  Catalog tmpCata;                 // 存最大mse_rate对应k的分类结果
-  DataSet::value_type prevMse = 1; // 前一个k的mse，计算mse_rate用
-  DataSet::value_type mseRate = 0; // 维护最大mseRate
-  std::size_t elbowK = 1;
+  Catalog tmpCata;    // 存最大mse_rate对应k的分类结果
+  Scalar prevMse = 1; // 前一个k的mse，计算mse_rate用
+  Scalar mseRate = 0; // 维护最大mseRate
+  int elbowK = minK;
 
   for (int k = minK; k <= maxK; k++) {
     double mse;
-    mKMeans(data, k, cata, &mse);
-    DataSet::value_type tmp_mseRate = prevMse / mse;
+    kmeans(data, k, cata, &mse);
+    Scalar tmp_mseRate = prevMse / mse;
     if (tmp_mseRate > mseRate) {
       mseRate = tmp_mseRate;
-      tmpCata = *cata;
+      std::swap(tmpCata, *cata); // 交换而非拷贝，*cata 会在下一轮被覆盖
       elbowK = k;
     }
     mseHist->emplace_back(k, mse);
@@ -37,8 +92,79 @@ Elbow::operator()(const DataSet& data,
     time("Elbow-iter");
   }
 
-  *cata = tmpCata;
-  *ansIndex = elbowK - 2; // 最大mse_rate对应k的"索引"
+  *cata = std::move(tmpCata);
+  *ansIndex = elbowK - minK; // 最大mse_rate对应k的"索引"
+}
+
+template<typename Data>
+void
+Elbow::sweep_tasks(const Data& data,
+                   Catalog* cata,
+                   History<Data>* mseHist,
+                   std::size_t* ansIndex,
+                   int minK,
+                   int maxK)
+{
+  using Scalar = typename Data::Scalar;
+
+  int n = maxK - minK + 1;
+  std::vector<double> mses(n, -1); // 为负表示尚未完成
+
+  // 比值 mse[i-1]/mse[i] 确定后，只保留当前最优的分类结果，比值尚未确定的结果
+  // 暂存在 pending 中。比值相同时取 k 小者，与依次评估的结果一致。
+  std::map<int, Catalog> pending;
+  Scalar bestRate = 0;
+  int best = -1;
+  std::mutex mutex;
+
+  auto settle = [&](int i) {
+    Scalar prevMse = i == 0 ? 1 : mses[i - 1];
+    Scalar rate = prevMse / Scalar(mses[i]);
+    if (rate > bestRate || (rate == bestRate && i < best)) {
+      if (best >= 0)
+        pending.erase(best);
+      bestRate = rate;
+      best = i;
+    } else
+      pending.erase(i);
+  };
+
+#pragma omp parallel for schedule(dynamic, 1)
+  for (int t = 0; t < n; ++t) {
+    int i = n - 1 - t; // 聚类数大的耗时长，先开始
+    omp_set_num_threads(1);
+
+    Catalog local;
+    double mse;
+    kmeans(data, minK + i, &local, &mse);
+
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      mses[i] = mse;
+      pending[i] = std::move(local);
+      if (i == 0 || mses[i - 1] >= 0)
+        settle(i);
+      if (i + 1 < n && mses[i + 1] >= 0)
+        settle(i + 1);
+    }
+
+    time("Elbow-iter");
+  }
+
+  for (int i = 0; i < n; ++i)
+    mseHist->emplace_back(minK + i, mses[i]);
+  *cata = std::move(pending.at(best));
+  *ansIndex = best;
+}
+
+template<typename Data>
+void
+Elbow::kmeans(const Data& data, int k, Catalog* cata, double* mse)
+{
+  if (mWarmStart)
+    mWarm(mKMeans, data, k, cata, mse);
+  else
+    mKMeans(data, k, cata, mse);
 }
 
 void
@@ -47,4 +173,18 @@ Elbow::KMeans::report(Profiler::Entry& entry) noexcept
   mSelf.report(entry);
 }
 
+#define LIB_INSTANTIATE(Code)                                                  \
+  template void Elbow::operator()(const Quantized<Code>&,                      \
+                                  Catalog*,                                    \
+                                  MseHistory*,                                 \
+                                  std::size_t*,                                \
+                                  int,                                         \
+                                  int);
+
+LIB_INSTANTIATE(std::int8_t)
+LIB_INSTANTIATE(Eigen::half)
+LIB_INSTANTIATE(Eigen::bfloat16)
+
+#undef LIB_INSTANTIATE
+
 } // namespace Lib
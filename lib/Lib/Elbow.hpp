@@ -2,12 +2,17 @@
 
 #include "KMeans.hpp"
 #include "Profiler.hpp"
+#include "WarmStart.hpp"
 #include "lib.hpp"
 
 namespace Lib {
 
 class Elbow : public Profiler
 {
+public:
+  bool mWarmStart{ false };     ///< 是否用相邻聚类数的结果热启动 KMeans
+  int mTaskThreshold{ 100000 }; ///< 点数少于该值时在聚类数之间并行
+
 public:
   /**
    * @param[in] data 数据集
@@ -17,14 +22,86 @@ public:
    * @param[in] minK 最小聚类数
    * @param[in] maxK 最大聚类数
    */
-  void operator()(const DataSet& data,
+  void operator()(const DataView& data,
+                  Catalog* cata,
+                  MseHistory* mseHist,
+                  std::size_t* ansIndex,
+                  int minK,
+                  int maxK);
+
+  /**
+   * @brief double 精度版。
+   */
+  void operator()(const F64DataView& data,
+                  Catalog* cata,
+                  F64MseHistory* mseHist,
+                  std::size_t* ansIndex,
+                  int minK,
+                  int maxK);
+
+  /**
+   * @brief 量化数据集版。
+   */
+  template<typename Code>
+  void operator()(const Quantized<Code>& data,
                   Catalog* cata,
                   MseHistory* mseHist,
                   std::size_t* ansIndex,
                   int minK,
                   int maxK);
 
+  /**
+   * @brief 获取内部使用的 KMeans 对象，用于配置其参数。
+   *
+   * 默认使用 k-means++ 初始化，以减少每个聚类数上的迭代次数。
+   */
+  Lib::KMeans& get_kmeans() noexcept { return mKMeans; }
+
 private:
+  WarmStart mWarm;
+
+  /**
+   * @brief 数据集 Data 上的误差历史，精度与数据集（解码后）相同。
+   */
+  template<typename Data>
+  using History = BasicMseHistory<typename Data::Scalar>;
+
+  template<typename Data>
+  void run(const Data& data,
+           Catalog* cata,
+           History<Data>* mseHist,
+           std::size_t* ansIndex,
+           int minK,
+           int maxK);
+
+  /**
+   * @brief 对聚类数 k 运行一次 KMeans，按 mWarmStart 决定是否热启动。
+   */
+  template<typename Data>
+  void kmeans(const Data& data, int k, Catalog* cata, double* mse);
+
+  /**
+   * @brief 依次评估各聚类数，每个 KMeans 内部并行。
+   */
+  template<typename Data>
+  void sweep(const Data& data,
+             Catalog* cata,
+             History<Data>* mseHist,
+             std::size_t* ansIndex,
+             int minK,
+             int maxK);
+
+  /**
+   * @brief 将各聚类数作为任务并行评估，聚类数大的先开始。
+   */
+  template<typename Data>
+  void sweep_tasks(const Data& data,
+                   Catalog* cata,
+                   History<Data>* mseHist,
+                   std::size_t* ansIndex,
+                   int minK,
+                   int maxK);
+
   class KMeans : public Lib::KMeans
   {
     Elbow& mSelf;
@@ -34,6 +111,7 @@ private:
       : Lib::KMeans(self)
       , mSelf(self)
     {
+      mInit = Init::kPlusPlus;
     }
 
     void report(Profiler::Entry& entry) noexcept override;
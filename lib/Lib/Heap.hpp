@@ -0,0 +1,127 @@
+/**
+ * @brief 这个文件为 LogMeans 搜索区间所用的堆，供算法与基准测试共用
+ */
+
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace Lib {
+
+/**
+ * @brief LogMeans 的搜索区间，mL 和 mR 为区间两端在误差历史中的下标。
+ */
+struct HeapEntry
+{
+  std::size_t mL, mR;
+};
+
+/**
+ * @brief 算法专用的大顶堆类，按区间两端的误差之比排序，堆顶为 (*this)[1]。
+ */
+template<typename Hist>
+struct Heap : public std::vector<HeapEntry>
+{
+  using _T = Heap;
+  using _S = std::vector<HeapEntry>;
+
+  Hist& mMseHist;
+
+  Heap(Hist& mseHist)
+    : _S(1) // 让下标从 1 开始
+    , mMseHist{ mseHist }
+  {
+  }
+
+  bool lt(const HeapEntry& lhs, const HeapEntry& rhs) const
+  {
+    return (mMseHist[lhs.mL].second / mMseHist[lhs.mR].second) <
+           (mMseHist[rhs.mL].second / mMseHist[rhs.mR].second);
+  }
+
+  bool gt(const HeapEntry& lhs, const HeapEntry& rhs) const
+  {
+    return (mMseHist[lhs.mL].second / mMseHist[lhs.mR].second) >
+           (mMseHist[rhs.mL].second / mMseHist[rhs.mR].second);
+  }
+
+  void heap_push(HeapEntry ent);
+
+  HeapEntry heap_pop();
+};
+
+template<typename Hist>
+void
+Heap<Hist>::heap_push(HeapEntry ent)
+{
+  auto i = size(); // 插入元素的索引
+  emplace_back(std::move(ent));
+  if ((size() & 1) != 0) {
+    auto& parent = (*this)[i >> 1];
+    auto& child = (*this)[i];
+    if (gt(child, parent))
+      std::swap(child, parent);
+    i >>= 1;
+  }
+
+  while ((i >>= 1) != 0) {
+    auto& parent = (*this)[i];
+    auto* child = &(*this)[i << 1];
+
+    if (gt(*(child + 1), *child))
+      ++child;
+    if (gt(*child, parent))
+      std::swap(*child, parent);
+  }
+}
+
+template<typename Hist>
+HeapEntry
+Heap<Hist>::heap_pop()
+{
+  assert(size() > 1);
+
+  auto ret = std::move((*this)[1]);
+  (*this)[1] = std::move(back());
+  pop_back();
+
+  auto i = 1;
+  auto* parent = &(*this)[i];
+  while ((i <<= 1) < size()) {
+    auto& lchild = (*this)[i];
+
+    if (i + 1 < size()) {
+      auto& rchild = (*this)[i + 1];
+
+      if (gt(lchild, rchild)) {
+        if (!gt(lchild, *parent))
+          break;
+
+        std::swap(*parent, lchild);
+        parent = &lchild;
+      }
+
+      else if (gt(rchild, *parent)) {
+        std::swap(*parent, rchild);
+        parent = &rchild;
+        ++i;
+      }
+
+      else
+        break;
+    }
+
+    else {
+      if (gt(lchild, *parent))
+        std::swap(*parent, lchild);
+      break;
+    }
+  }
+
+  return ret;
+}
+
+} // namespace Lib
@@ -1,97 +1,660 @@
 #include "KMeans.hpp"
+#include "kernels.hpp"
+#include <algorithm>
 #include <random>
 #include <sstream>
 #include <string>
 
-using namespace std::string_literals;
-
 namespace Lib {
 
-void
-KMeans::operator()(const DataSet& data, int k, Catalog* cata, double* mse)
+using namespace kernels;
+
+namespace {
+
+/**
+ * @brief Hamerly 算法的分配状态。
+ *
+ * 对每个点维护到所属中心的距离上界 mUpper 和到其它中心的距离下界 mLower，
+ * 中心点移动后按漂移量放宽上下界；若上界不超过下界和所属中心到其它中心
+ * 最近距离的一半，则最近中心不变，无需与其它中心计算距离。
+ *
+ * 为了得到与朴素算法完全一致的误差，每轮仍会精确计算点到所属中心的距离，
+ * 这同时也收紧了上界。
+ */
+template<typename Data>
+class Hamerly
 {
-  static thread_local std::default_random_engine stRand{
-    std::random_device()()
-  };
+public:
+  using Scalar = typename Data::Scalar;
+  using Centers = CentersOf<Data>;
 
-  Scope scopeKMeans(*this, "KMeans");
+  /**
+   * @return 平均距离
+   */
+  double operator()(const Data& data, const Centers& centers, Catalog& labels)
+  {
+    if (mLast.size() == 0)
+      return init(data, centers, labels);
 
-  int dims = data.rows();
-  int dataNums = data.cols();
+    int k = centers.cols();
+    int dataNums = data.cols();
+
+    // 中心点漂移量，以及最大、次大漂移量（用于放宽下界）
+    Eigen::Matrix<Scalar, Eigen::Dynamic, 1> drift(k);
+    int maxIdx = 0;
+    Scalar maxDrift = 0, secDrift = 0;
+    for (int j = 0; j < k; ++j) {
+      drift(j) = (centers.col(j) - mLast.col(j)).norm();
+      if (drift(j) > maxDrift)
+        secDrift = maxDrift, maxDrift = drift(j), maxIdx = j;
+      else if (drift(j) > secDrift)
+        secDrift = drift(j);
+    }
+    mLast = centers;
+
+    // 每个中心到其它中心最近距离的一半
+    Eigen::Matrix<Scalar, Eigen::Dynamic, 1> half(k);
+    half.setConstant(std::numeric_limits<Scalar>::max());
+    for (int j = 0; j < k; ++j) {
+      for (int jj = j + 1; jj < k; ++jj) {
+        auto dist = (centers.col(j) - centers.col(jj)).norm() / 2;
+        half(j) = std::min(half(j), dist);
+        half(jj) = std::min(half(jj), dist);
+      }
+    }
+
+    FixedCenters ctrs = centers;
+    double sse = 0;
+#pragma omp parallel for reduction(+ : sse)
+    for (int i = 0; i < dataNums; ++i) {
+      int a = labels(i);
+      mLower(i) -= a == maxIdx ? secDrift : maxDrift;
+
+      auto bound = std::max(half(a), mLower(i));
+      auto dist = (data.col(i) - ctrs.col(a)).norm();
+      mUpper(i) = dist;
+      if (dist > bound)
+        scan(data, ctrs, labels, i);
+
+      sse += double(mUpper(i)) / dataNums;
+    }
+    return sse;
+  }
+
+private:
+  /**
+   * @brief 与数据集维数相同的中心点矩阵，维数固定时距离计算可以完全展开。
+   */
+  using FixedCenters = Eigen::Matrix<Scalar, kDims<Data>, Eigen::Dynamic>;
+
+  Centers mLast; ///< 上一轮的中心点
+  Eigen::Matrix<Scalar, Eigen::Dynamic, 1> mUpper, mLower;
 
-  // 初始化：从数据中随机选k个
-  DataSet centers(dims, k);
+  double init(const Data& data, const Centers& centers, Catalog& labels)
+  {
+    int dataNums = data.cols();
+    mLast = centers;
+    mUpper.resize(dataNums);
+    mLower.resize(dataNums);
+
+    FixedCenters ctrs = centers;
+    double sse = 0;
+#pragma omp parallel for reduction(+ : sse)
+    for (int i = 0; i < dataNums; ++i) {
+      scan(data, ctrs, labels, i);
+      sse += double(mUpper(i)) / dataNums;
+    }
+    return sse;
+  }
+
+  /**
+   * @brief 计算点 i 到所有中心的距离，重置其类别和上下界。
+   */
+  void scan(const Data& data,
+            const FixedCenters& centers,
+            Catalog& labels,
+            int i)
+  {
+    int k = centers.cols();
+    auto minDist = std::numeric_limits<Scalar>::max();
+    auto secDist = std::numeric_limits<Scalar>::max();
+    int minIdx = -1;
+    for (int j = 0; j < k; j++) {
+      auto dist = (data.col(i) - centers.col(j)).norm();
+      if (dist < minDist)
+        secDist = minDist, minDist = dist, minIdx = j;
+      else if (dist < secDist)
+        secDist = dist;
+    }
+    assert(minIdx != -1);
+    labels(i) = minIdx;
+    mUpper(i) = minDist;
+    mLower(i) = secDist;
+  }
+};
+
+constexpr int kSeedChunks = 64;     ///< 初始化时并行处理数据的分段数上限
+constexpr int kParallelRounds = 5;  ///< k-means|| 的过采样轮数
+constexpr int kReclusterIters = 10; ///< k-means|| 聚类候选点的迭代数上限
+
+/**
+ * @brief 分层随机初始化：将数据集均分为 k 段，每段随机选一个点。
+ */
+template<typename Data>
+void
+init_stratified(const Data& data,
+                int k,
+                Random& rand,
+                CentersOf<Data>& centers)
+{
+  int dataNums = data.cols();
+  centers.resize(data.rows(), k);
   for (std::uint64_t i = 0; i < k; ++i) {
     auto x = std::uniform_int_distribution<>(
-      i * dataNums / k, (i + 1) * dataNums / k - 1)(stRand);
+      i * dataNums / k, (i + 1) * dataNums / k - 1)(rand);
     centers.col(i) = data.col(x);
   }
+}
+
+/**
+ * @brief 到已选中心的最近距离平方，按固定的分段维护各段的和，以便并行更新
+ * 和按权采样，且结果与线程数无关。
+ */
+template<typename Data>
+class MinDist
+{
+public:
+  Eigen::VectorXd mDist;  ///< 每个点到已选中心的最近距离平方
+  Eigen::VectorXi mIndex; ///< 每个点最近的已选中心的序号
+  Eigen::VectorXd mSums;  ///< 每段中 mDist（乘以权重后）的和
+
+public:
+  /**
+   * @param weights 点的权重，为空则全为 1。
+   */
+  MinDist(const Data& data, const Eigen::VectorXd* weights)
+    : mData(data)
+    , mWeights(weights)
+    , mChunks(std::min<int>(kSeedChunks, data.cols()))
+  {
+    mDist.setConstant(data.cols(), std::numeric_limits<double>::infinity());
+    mIndex.setConstant(data.cols(), -1);
+    mSums.setZero(mChunks);
+  }
+
+  int chunks() const { return mChunks; }
+
+  int chunk_begin(int c) const
+  {
+    return std::int64_t(mData.cols()) * c / mChunks;
+  }
+
+  /**
+   * @brief 用 centers 中序号在 [begin, end) 中的中心点更新最近距离。
+   */
+  void update(const CentersOf<Data>& centers, int begin, int end)
+  {
+#pragma omp parallel for schedule(static)
+    for (int c = 0; c < mChunks; ++c) {
+      double sum = 0;
+      for (int i = chunk_begin(c), iend = chunk_begin(c + 1); i < iend; ++i) {
+        for (int j = begin; j < end; ++j) {
+          double dist = (mData.col(i) - centers.col(j)).squaredNorm();
+          if (dist < mDist(i))
+            mDist(i) = dist, mIndex(i) = j;
+        }
+        sum += weight(i);
+      }
+      mSums(c) = sum;
+    }
+  }
+
+  /**
+   * @brief 采样权重：点的权重乘以最近距离平方。
+   */
+  double weight(int i) const
+  {
+    return mWeights ? (*mWeights)(i) * mDist(i) : mDist(i);
+  }
+
+  /**
+   * @brief 按采样权重随机抽取一个点。
+   */
+  int sample(Random& rand) const
+  {
+    double r = std::uniform_real_distribution<>(0, mSums.sum())(rand);
+    int c = 0;
+    while (c + 1 < mChunks && r >= mSums(c))
+      r -= mSums(c++);
+
+    int last = chunk_begin(c);
+    for (int i = last, end = chunk_begin(c + 1); i < end; ++i) {
+      if (weight(i) > 0) {
+        last = i;
+        if (r < weight(i))
+          break;
+        r -= weight(i);
+      }
+    }
+    return last;
+  }
+
+private:
+  const Data& mData;
+  const Eigen::VectorXd* mWeights;
+  int mChunks;
+};
+
+/**
+ * @brief k-means++ 初始化：首个中心按权重随机选取，之后每个中心按“权重 ×
+ * 到已选中心的最近距离平方”加权采样。
+ *
+ * @param weights 点的权重，为空则全为 1。
+ */
+template<typename Data>
+void
+init_plusplus(const Data& data,
+              const Eigen::VectorXd* weights,
+              int k,
+              Random& rand,
+              CentersOf<Data>& centers)
+{
+  MinDist<Data> minDist(data, weights);
+  centers.resize(data.rows(), k);
+
+  int first;
+  if (weights) {
+    std::discrete_distribution<> dist(weights->data(),
+                                      weights->data() + weights->size());
+    first = dist(rand);
+  } else
+    first = std::uniform_int_distribution<>(0, data.cols() - 1)(rand);
+  centers.col(0) = data.col(first);
+
+  for (int j = 1; j < k; ++j) {
+    minDist.update(centers, j - 1, j);
+    if (minDist.mSums.sum() > 0)
+      centers.col(j) = data.col(minDist.sample(rand));
+    else // 不同的点已经选完
+      centers.col(j) = centers.col(j - 1);
+  }
+}
+
+/**
+ * @brief k-means|| 初始化。
+ *
+ * 进行 kParallelRounds 轮过采样，每轮对每个点独立地以正比于到已选候选点最近
+ * 距离平方的概率（期望共 2k 个）选为候选点，然后以每个候选点所吸引的点数为
+ * 权重，对候选点进行 k-means++ 初始化和若干轮加权 Lloyd 迭代，得到 k 个中心。
+ */
+template<typename Data>
+void
+init_parallel(const Data& data, int k, Random& rand, CentersOf<Data>& centers)
+{
+  using Scalar = typename Data::Scalar;
+  int dims = data.rows();
+  int dataNums = data.cols();
+  double oversample = 2.0 * k;
+
+  MinDist<Data> minDist(data, nullptr);
+  CentersOf<Data> cands(dims, 1);
+  auto first = std::uniform_int_distribution<>(0, dataNums - 1)(rand);
+  cands.col(0) = data.col(first);
+  minDist.update(cands, 0, 1);
+
+  for (int r = 0; r < kParallelRounds; ++r) {
+    double psi = minDist.mSums.sum();
+    if (psi == 0)
+      break;
+
+    // 每段使用独立的随机数引擎，使采样结果与线程数无关
+    std::vector<Random::result_type> seeds(minDist.chunks());
+    for (auto& seed : seeds)
+      seed = rand();
+
+    std::vector<std::vector<int>> picked(minDist.chunks());
+#pragma omp parallel for schedule(static)
+    for (int c = 0; c < minDist.chunks(); ++c) {
+      Random chunkRand(seeds[c]);
+      std::uniform_real_distribution<> uniform;
+      for (int i = minDist.chunk_begin(c), end = minDist.chunk_begin(c + 1);
+           i < end;
+           ++i) {
+        if (uniform(chunkRand) * psi < oversample * minDist.mDist(i))
+          picked[c].push_back(i);
+      }
+    }
+
+    int begin = cands.cols(), end = begin;
+    for (auto& ids : picked)
+      end += ids.size();
+    cands.conservativeResize(Eigen::NoChange, end);
+    int j = begin;
+    for (auto& ids : picked) {
+      for (auto i : ids)
+        cands.col(j++) = data.col(i);
+    }
+    minDist.update(cands, begin, end);
+  }
+
+  if (cands.cols() <= k) {
+    init_plusplus(data, nullptr, k, rand, centers);
+    return;
+  }
+
+  Eigen::VectorXd weights;
+  weights.setZero(cands.cols());
+  for (int i = 0; i < dataNums; ++i)
+    weights(minDist.mIndex(i)) += 1;
+
+  init_plusplus(cands, &weights, k, rand, centers);
+
+  // 在候选点上进行加权 Lloyd 迭代
+  Eigen::VectorXi labels(cands.cols());
+  for (int step = 0; step < kReclusterIters; ++step) {
+    bool changed = false;
+    for (int i = 0; i < cands.cols(); ++i) {
+      int label;
+      (centers.colwise() - cands.col(i)).colwise().squaredNorm().minCoeff(
+        &label);
+      changed |= step == 0 || label != labels(i);
+      labels(i) = label;
+    }
+    if (!changed)
+      break;
+
+    Eigen::MatrixXd sums = Eigen::MatrixXd::Zero(dims, k);
+    Eigen::VectorXd counts = Eigen::VectorXd::Zero(k);
+    for (int i = 0; i < cands.cols(); ++i) {
+      sums.col(labels(i)) += cands.col(i).template cast<double>() * weights(i);
+      counts(labels(i)) += weights(i);
+    }
+    for (int j = 0; j < k; ++j) {
+      if (counts(j) > 0)
+        centers.col(j) = (sums.col(j) / counts(j)).cast<Scalar>();
+    }
+  }
+}
+
+constexpr int kMaxNoImprovement = 10; ///< 小批量模式下误差连续未改善的批数上限
+
+/**
+ * @brief 迭代结束后的收尾。量化数据集迭代中的距离是在编码上按 float 计算的，
+ * 因此在最终的中心点上重新分配一次，并以 double 精度解码计算误差。
+ */
+template<typename Data>
+void
+finish(const Data&, const CentersOf<Data>&, Catalog&, double*)
+{
+}
+
+template<typename Code>
+void
+finish(const Quantized<Code>& data,
+       const DataSet& centers,
+       Catalog& labels,
+       double* mse)
+{
+  assign_lloyd(data, centers, labels);
+  *mse = exact_mse(data, centers, labels);
+}
+
+}
+
+void
+KMeans::operator()(const DataView& data,
+                   int k,
+                   Catalog* cata,
+                   double* mse,
+                   DataSet* centers)
+{
+  dispatch_dims(data, [&](const auto& view) {
+    cluster(view, k, cata, mse, centers);
+  });
+}
+
+void
+KMeans::operator()(const DataView& data,
+                   DataSet* centers,
+                   Catalog* cata,
+                   double* mse)
+{
+  dispatch_dims(
+    data, [&](const auto& view) { resume(view, centers, cata, mse); });
+}
+
+void
+KMeans::operator()(const F64DataView& data,
+                   int k,
+                   Catalog* cata,
+                   double* mse,
+                   F64DataSet* centers)
+{
+  dispatch_dims(data, [&](const auto& view) {
+    cluster(view, k, cata, mse, centers);
+  });
+}
+
+void
+KMeans::operator()(const F64DataView& data,
+                   F64DataSet* centers,
+                   Catalog* cata,
+                   double* mse)
+{
+  dispatch_dims(
+    data, [&](const auto& view) { resume(view, centers, cata, mse); });
+}
+
+template<typename Code>
+void
+KMeans::operator()(const Quantized<Code>& data,
+                   int k,
+                   Catalog* cata,
+                   double* mse,
+                   DataSet* centers)
+{
+  cluster(data, k, cata, mse, centers);
+}
+
+template<typename Code>
+void
+KMeans::operator()(const Quantized<Code>& data,
+                   DataSet* centers,
+                   Catalog* cata,
+                   double* mse)
+{
+  resume(data, centers, cata, mse);
+}
+
+template<typename Data>
+void
+KMeans::cluster(const Data& data,
+                int k,
+                Catalog* cata,
+                double* mse,
+                Centers<Data>* centers)
+{
+  Random rand = make_random(mSeed);
+
+  Scope scopeKMeans(*this, "KMeans");
+
+  // 初始化：从数据中选k个
+  Centers<Data> initial;
+  auto& ctrs = centers ? *centers : initial;
+  switch (mInit) {
+    case Init::kStratified:
+      init_stratified(data, k, rand, ctrs);
+      break;
+
+    case Init::kPlusPlus:
+      init_plusplus(data, nullptr, k, rand, ctrs);
+      break;
+
+    case Init::kParallel:
+      init_parallel(data, k, rand, ctrs);
+      break;
+  }
   time("KMeans-init");
 
-  auto& labels = *cata;
-  labels.resize(dataNums);
-  Eigen::VectorXi kcount(k); // 每轮隶属某个中心点的点数量
+  iterate(data, ctrs, *cata, mse, rand);
+}
+
+template<typename Data>
+void
+KMeans::resume(const Data& data,
+               Centers<Data>* centers,
+               Catalog* cata,
+               double* mse)
+{
+  assert(centers->rows() == data.rows() && centers->cols() > 0);
+
+  Random rand = make_random(mSeed);
+
+  Scope scopeKMeans(*this, "KMeans");
+
+  iterate(data, *centers, *cata, mse, rand);
+}
+
+template<typename Data>
+void
+KMeans::iterate(const Data& data,
+                Centers<Data>& centers,
+                Catalog& labels,
+                double* mse,
+                Random& rand)
+{
+  labels.resize(data.cols());
+  if (mEngine == Engine::kMiniBatch)
+    mini_batch(data, centers, labels, mse, rand);
+  else
+    lloyd(data, centers, labels, mse, rand);
+}
+
+template<typename Data>
+void
+KMeans::lloyd(const Data& data,
+              Centers<Data>& centers,
+              Catalog& labels,
+              double* mse,
+              Random& rand)
+{
+  int k = centers.cols();
+  int dataNums = data.cols();
+
+  using Scalar = typename Data::Scalar;
+  Hamerly<Data> hamerly;
+  Accumulator accum;
   double mseLast = 0;
   for (int step = 0;; step++) {
     // 分类，对数据集中每个点，找到最近的k_idx
-    double sse = 0;
-#pragma omp parallel for reduction(+ : sse)
-    for (int i = 0; i < dataNums; ++i) {
-      auto minDist = std::numeric_limits<DataSet::value_type>::max();
-      int minIdx = -1;
-      for (int j = 0; j < k; j++) {
-        auto dist = (data.col(i) - centers.col(j)).norm();
-        if (dist < minDist)
-          minDist = dist, minIdx = j;
-      }
-      labels(i) = minIdx;
-      assert(minIdx != -1);
-      sse += double(minDist) / dataNums; // 在加之前先除，防止数据过大而溢出
+    switch (mEngine) {
+      case Engine::kLloyd:
+        *mse = assign_lloyd(data, centers, labels);
+        break;
+
+      case Engine::kHamerly:
+        *mse = hamerly(data, centers, labels);
+        break;
+
+      case Engine::kGemm:
+        *mse = assign_gemm(data, centers, labels);
+        break;
+
+      default:
+        assert(false);
     }
-    *mse = sse;
 
     // 更新聚类中心
-    centers.setZero();
-    kcount.setZero();
-#pragma omp parallel for
-    for (int i = 0; i < dataNums; ++i) {
-      int tmp = labels(i);
-      centers.col(tmp) += data.col(i);
-      ++kcount(tmp);
-    }
+    accum(data, labels, k);
+    const auto& kcount = accum.counts(); // 隶属每个中心点的点数量
     for (int i = 0; i < k; ++i) {
       if (kcount(i) == 0) {
         // 应对离群中心点，重新随机生成
-        int idx = std::uniform_int_distribution<>(0, dataNums - 1)(stRand);
+        int idx = std::uniform_int_distribution<>(0, dataNums - 1)(rand);
         centers.col(i) = data.col(idx);
       } else {
-        centers.col(i) /= kcount(i);
+        centers.col(i) = (accum.sums().col(i) / kcount(i)).cast<Scalar>();
       }
     }
 
     // 收敛条件
     if (std::abs((*mse - mseLast) / *mse) < mEpsRatio)
       break;
-    mseLast = (mseLast + *mse) / 2; // 平滑
+    // 平滑，首轮直接取当前误差，否则从 0 开始平滑会强制迭代约 log2(1/eps) 轮
+    mseLast = step == 0 ? *mse : (mseLast + *mse) / 2;
 
-    struct IterInfo : public Profiler::Info
-    {
-      int mStep;
-      double mMse;
+    time("KMeans-iter", Inline("MSE[{}]={}", step, *mse));
+  }
 
-      IterInfo(int step, double mse)
-        : mStep(step)
-        , mMse(mse)
-      {
-      }
+  finish(data, centers, labels, mse);
+}
 
-      std::string info() noexcept override
-      {
-        return "MSE["s + std::to_string(mStep) + "]=" + std::to_string(mMse);
-      }
-    }* info = new IterInfo(step, *mse);
-    time("KMeans-iter", info, true);
+template<typename Data>
+void
+KMeans::mini_batch(const Data& data,
+                   Centers<Data>& centers,
+                   Catalog& labels,
+                   double* mse,
+                   Random& rand)
+{
+  int k = centers.cols();
+  int dataNums = data.cols();
+  int batchSize = std::min(mBatchSize, dataNums);
+
+  using Scalar = typename Data::Scalar;
+  Centers<Data> batch(data.rows(), batchSize);
+  Catalog batchLabels(batchSize);
+  Accumulator accum;
+  Eigen::VectorXd seen = Eigen::VectorXd::Zero(k); // 每个中心累计分到的点数
+  std::uniform_int_distribution<> pick(0, dataNums - 1);
+
+  // 批误差的指数加权平均，平滑系数同 sklearn 的 MiniBatchKMeans
+  double alpha = std::min(1.0, 2.0 * batchSize / (dataNums + 1.0));
+  double ewa = 0, best = std::numeric_limits<double>::max();
+  int noImprovement = 0;
+
+  for (int step = 0; step < mMaxBatches; ++step) {
+    for (int i = 0; i < batchSize; ++i)
+      batch.col(i) = data.col(pick(rand));
+    auto batchMse = assign_lloyd(batch, centers, batchLabels);
+
+    // 每个中心向分到的点的均值移动，学习率为本批点数 / 累计点数
+    accum(batch, batchLabels, k);
+    const auto& kcount = accum.counts();
+    for (int j = 0; j < k; ++j) {
+      if (kcount(j) == 0)
+        continue;
+      seen(j) += kcount(j);
+      auto delta = accum.sums().col(j) -
+                   kcount(j) * centers.col(j).template cast<double>();
+      centers.col(j) += (delta / seen(j)).template cast<Scalar>();
+    }
+
+    ewa = step == 0 ? batchMse : ewa * (1 - alpha) + batchMse * alpha;
+    time("KMeans-batch", Inline("MSE[{}]={}", step, ewa));
+
+    // 收敛条件：平滑后的批误差连续多批没有明显下降
+    if (ewa < best * (1 - mEpsRatio))
+      best = ewa, noImprovement = 0;
+    else if (++noImprovement >= kMaxNoImprovement)
+      break;
   }
-};
+
+  // 最后对整个数据集分类一次
+  *mse = assign_lloyd(data, centers, labels);
+  finish(data, centers, labels, mse);
+}
+
+#define LIB_INSTANTIATE(Code)                                                  \
+  template void KMeans::operator()(                                            \
+    const Quantized<Code>&, int, Catalog*, double*, DataSet*);                 \
+  template void KMeans::operator()(                                            \
+    const Quantized<Code>&, DataSet*, Catalog*, double*);
+
+LIB_INSTANTIATE(std::int8_t)
+LIB_INSTANTIATE(Eigen::half)
+LIB_INSTANTIATE(Eigen::bfloat16)
+
+#undef LIB_INSTANTIATE
 
 } // namespace Lib
@@ -6,14 +6,43 @@
 #pragma once
 
 #include "Profiler.hpp"
+#include "Quantized.hpp"
 #include "lib.hpp"
+#include <random>
 
 namespace Lib {
 
 class KMeans : public Profiler
 {
+public:
+  /**
+   * @brief 分配步骤（为每个点寻找最近中心点）所使用的算法。
+   */
+  enum class Engine
+  {
+    kLloyd,     ///< 朴素算法，每轮计算每个点到所有中心点的距离
+    kHamerly,   ///< Hamerly 算法，维护距离上下界以跳过大部分距离计算
+    kGemm,      ///< 分块矩阵乘法，适合维数和聚类数都较大的情形
+    kMiniBatch, ///< 小批量随机更新中心点，最后对全体数据分类一次
+  };
+
+  /**
+   * @brief 初始中心点的选取方法。
+   */
+  enum class Init
+  {
+    kStratified, ///< 将数据集均分为 k 段，每段随机选一个点
+    kPlusPlus,   ///< k-means++，按到已选中心的距离平方加权采样
+    kParallel,   ///< k-means||，多轮并行过采样后再聚类候选点
+  };
+
 public:
   DataSet::value_type mEpsRatio{ 0.001 }; ///< 判断收敛的MSE变化率阈值
+  Engine mEngine{ Engine::kLloyd };       ///< 分配步骤所用算法
+  Init mInit{ Init::kStratified };        ///< 初始中心点的选取方法
+  unsigned mSeed{ 0 };                    ///< 随机数种子，为 0 时随机生成
+  int mBatchSize{ 1024 };                 ///< 小批量模式下每批的点数
+  int mMaxBatches{ 1000 };                ///< 小批量模式下的最大批数
 
 public:
   KMeans() = default;
@@ -34,8 +63,113 @@ public:
    * @param[in] k 聚类数
    * @param[out] cata 聚类结果
    * @param[out] mse 误差
+   * @param[out] centers 最终的中心点，可为空
+   */
+  void operator()(const DataView& data,
+                  int k,
+                  Catalog* cata,
+                  double* mse,
+                  DataSet* centers = nullptr);
+
+  /**
+   * @brief 从给定的中心点开始迭代（热启动），聚类数为中心点的个数。
+   *
+   * @param[in] data 数据集
+   * @param[in,out] centers 输入初始中心点，输出最终的中心点
+   * @param[out] cata 聚类结果
+   * @param[out] mse 误差
+   */
+  void operator()(const DataView& data,
+                  DataSet* centers,
+                  Catalog* cata,
+                  double* mse);
+
+  /**
+   * @brief double 精度版，中心点与距离均按 double 计算，数据不经转换。
+   */
+  void operator()(const F64DataView& data,
+                  int k,
+                  Catalog* cata,
+                  double* mse,
+                  F64DataSet* centers = nullptr);
+
+  /**
+   * @brief double 精度的热启动版。
+   */
+  void operator()(const F64DataView& data,
+                  F64DataSet* centers,
+                  Catalog* cata,
+                  double* mse);
+
+  /**
+   * @brief 量化数据集版，分配步骤直接在编码上计算距离。
+   *
+   * 迭代结束后在最终的中心点上重新分配一次，并以 double 精度计算误差。
+   */
+  template<typename Code>
+  void operator()(const Quantized<Code>& data,
+                  int k,
+                  Catalog* cata,
+                  double* mse,
+                  DataSet* centers = nullptr);
+
+  /**
+   * @brief 量化数据集的热启动版。
+   */
+  template<typename Code>
+  void operator()(const Quantized<Code>& data,
+                  DataSet* centers,
+                  Catalog* cata,
+                  double* mse);
+
+private:
+  using Random = std::default_random_engine;
+
+  /**
+   * @brief 数据集 Data 上的中心点矩阵，标量类型与数据集（解码后）相同。
+   */
+  template<typename Data>
+  using Centers = BasicDataSet<typename Data::Scalar>;
+
+  template<typename Data>
+  void cluster(const Data& data,
+               int k,
+               Catalog* cata,
+               double* mse,
+               Centers<Data>* centers);
+
+  template<typename Data>
+  void resume(const Data& data,
+              Centers<Data>* centers,
+              Catalog* cata,
+              double* mse);
+
+  template<typename Data>
+  void iterate(const Data& data,
+               Centers<Data>& centers,
+               Catalog& labels,
+               double* mse,
+               Random& rand);
+
+  /**
+   * @brief 从初始中心点 centers 开始进行 Lloyd 迭代直到收敛。
+   */
+  template<typename Data>
+  void lloyd(const Data& data,
+             Centers<Data>& centers,
+             Catalog& labels,
+             double* mse,
+             Random& rand);
+
+  /**
+   * @brief 从初始中心点 centers 开始进行小批量迭代直到收敛。
    */
-  void operator()(const DataSet& data, int k, Catalog* cata, double* mse);
+  template<typename Data>
+  void mini_batch(const Data& data,
+                  Centers<Data>& centers,
+                  Catalog& labels,
+                  double* mse,
+                  Random& rand);
 };
 
 } // namespace Lib
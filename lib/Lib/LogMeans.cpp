@@ -1,156 +1,74 @@
 #include "LogMeans.hpp"
+#include "Heap.hpp"
 
+#include <algorithm>
 #include <cassert>
+#include <functional>
 #include <iostream>
 #include <map>
+#include <omp.h>
 #include <tuple>
 #include <vector>
 
-#define self (*this)
-
 namespace Lib {
 
-namespace {
-
-struct HeapEntry
+void
+LogMeans::operator()(const DataView& data,
+                     Catalog* cata,
+                     MseHistory* mseHist,
+                     std::size_t* ansIndex,
+                     int minK,
+                     int maxK)
 {
-  std::size_t mL, mR;
-};
+  run(data, cata, mseHist, ansIndex, minK, maxK);
+}
 
-/**
- * @brief 算法专用的大顶堆类。
- */
-struct Heap : public std::vector<HeapEntry>
+void
+LogMeans::operator()(const F64DataView& data,
+                     Catalog* cata,
+                     F64MseHistory* mseHist,
+                     std::size_t* ansIndex,
+                     int minK,
+                     int maxK)
 {
-  using _T = Heap;
-  using _S = std::vector<HeapEntry>;
-
-  MseHistory& mMseHist;
-
-  Heap(MseHistory& mseHist)
-    : _S(1) // 让下标从 1 开始
-    , mMseHist{ mseHist }
-  {
-  }
-
-  bool lt(const HeapEntry& lhs, const HeapEntry& rhs) const
-  {
-    return (mMseHist[lhs.mL].second / mMseHist[lhs.mR].second) <
-           (mMseHist[rhs.mL].second / mMseHist[rhs.mR].second);
-  }
-
-  bool gt(const HeapEntry& lhs, const HeapEntry& rhs) const
-  {
-    return (mMseHist[lhs.mL].second / mMseHist[lhs.mR].second) >
-           (mMseHist[rhs.mL].second / mMseHist[rhs.mR].second);
-  }
-
-  // void heapify();
-
-  void heap_push(HeapEntry ent);
-
-  HeapEntry heap_pop();
-};
-
-// void
-// Heap::heapify()
-// {
-//   auto i = size() >> 1;
-//   if ((size() & 1) != 0) {
-//     auto& parent = self[i];
-//     auto& child = self[i << 1];
-//     if (child > parent)
-//       std::swap(child, parent);
-//     --i;
-//   }
-
-//   while (i != 0) {
-//     auto& parent = self[i];
-//     auto* child = &self[i << 1];
-
-//     if (*(child + 1) > *child)
-//       ++child;
-//     if (*child > parent)
-//       std::swap(*child, parent);
-
-//     --i;
-//   }
-// }
+  run(data, cata, mseHist, ansIndex, minK, maxK);
+}
 
+template<typename Code>
 void
-Heap::heap_push(HeapEntry ent)
+LogMeans::operator()(const Quantized<Code>& data,
+                     Catalog* cata,
+                     MseHistory* mseHist,
+                     std::size_t* ansIndex,
+                     int minK,
+                     int maxK)
 {
-  auto i = size(); // 插入元素的索引
-  emplace_back(std::move(ent));
-  if ((size() & 1) != 0) {
-    auto& parent = self[i >> 1];
-    auto& child = self[i];
-    if (gt(child, parent))
-      std::swap(child, parent);
-    i >>= 1;
-  }
-
-  while ((i >>= 1) != 0) {
-    auto& parent = self[i];
-    auto* child = &self[i << 1];
-
-    if (gt(*(child + 1), *child))
-      ++child;
-    if (gt(*child, parent))
-      std::swap(*child, parent);
-  }
+  run(data, cata, mseHist, ansIndex, minK, maxK);
 }
 
-HeapEntry
-Heap::heap_pop()
+template<typename Data>
+void
+LogMeans::run(const Data& data,
+              Catalog* cata,
+              History<Data>* mseHist,
+              std::size_t* ansIndex,
+              int minK,
+              int maxK)
 {
-  assert(size() > 1);
-
-  auto ret = std::move(self[1]);
-  self[1] = std::move(back());
-  pop_back();
-
-  auto i = 1;
-  auto* parent = &self[i];
-  while ((i <<= 1) < size()) {
-    auto& lchild = self[i];
-
-    if (i + 1 < size()) {
-      auto& rchild = self[i + 1];
-
-      if (gt(lchild, rchild)) {
-        if (!gt(lchild, *parent))
-          break;
-
-        std::swap(*parent, lchild);
-        parent = &lchild;
-      }
-
-      else if (gt(rchild, *parent)) {
-        std::swap(*parent, rchild);
-        parent = &rchild;
-        ++i;
-      }
-
-      else
-        break;
-    }
-
-    else {
-      if (gt(lchild, *parent))
-        std::swap(*parent, lchild);
-      break;
-    }
-  }
-
-  return ret;
-}
+  Profiler::Scope scopeProf(*this, "LogMeans");
 
+  mWarm.clear();
+  search(
+    [&](const std::vector<int>& ks) { evaluate(data, ks, cata, mseHist); },
+    mseHist,
+    ansIndex,
+    minK,
+    maxK);
 }
 
 void
-LogMeans::operator()(const DataSet& data,
-                     Catalog* cata,
+LogMeans::operator()(const char* dataPath,
+                     const char* cataPath,
                      MseHistory* mseHist,
                      std::size_t* ansIndex,
                      int minK,
@@ -158,80 +76,146 @@ LogMeans::operator()(const DataSet& data,
 {
   Profiler::Scope scopeProf(*this, "LogMeans");
 
+  // 每个聚类数都要完整地扫描文件数次，同时评估多个区间只会争抢磁盘带宽，
+  // 因此总是逐个评估；搜索时不输出聚类结果，免得每个 k 多扫描一遍并重写
+  search(
+    [&](const std::vector<int>& ks) {
+      for (auto k : ks) {
+        double mse;
+        mStream(dataPath, k, nullptr, &mse);
+        mseHist->emplace_back(k, mse);
+      }
+    },
+    mseHist,
+    ansIndex,
+    minK,
+    maxK);
+
+  // 只为最终的聚类数输出一次聚类结果
+  if (cataPath) {
+    double mse;
+    mStream(dataPath, (*mseHist)[*ansIndex].first, cataPath, &mse);
+  }
+}
+
+template<typename _Scalar>
+void
+LogMeans::search(const std::function<void(const std::vector<int>&)>& evaluate,
+                 BasicMseHistory<_Scalar>* mseHist,
+                 std::size_t* ansIndex,
+                 int minK,
+                 int maxK)
+{
   mseHist->clear();
 
   /**
-   * xxxIndex 变量里存的是 mseHist 中项的索引，
+   * 堆中区间的端点是 mseHist 中项的索引，
    * mseHist 中保存的是聚类数 k 到 mse 的映射。
    */
 
-  std::size_t lftIndex = 0;
-  {
-    double mse;
-    mKMeans(data, minK, cata, &mse);
-    mseHist->emplace_back(minK, mse);
-  }
-
-  std::size_t rhtIndex = 1;
-  {
-    double mse;
-    mKMeans(data, maxK, cata, &mse);
-    mseHist->emplace_back(maxK, mse);
-  }
+  evaluate({ minK, maxK });
 
   time("LogMeans-iterstart");
 
   auto& hist = *mseHist;
-  Heap heap(hist);
-  while (hist[rhtIndex].first - hist[lftIndex].first > 1) {
-    auto lft = hist[lftIndex].first;
-    auto rht = hist[rhtIndex].first;
-    auto mid = (lft + rht) / 2;
-    std::size_t midIndex;
-
-    midIndex = mseHist->size();
-    double mse;
-    mKMeans(data, mid, cata, &mse);
-    mseHist->emplace_back(mid, mse);
+  Heap<BasicMseHistory<_Scalar>> heap(hist);
+  heap.heap_push({ 0, 1 });
+
+  std::vector<HeapEntry> batch;
+  std::vector<int> mids;
+  while (true) {
+    // 依次取出比值最大的至多 mConcurrency 个区间，直到遇到不可再分的区间。
+    // 堆顶区间不可再分时算法结束，这与逐个评估时的结束条件相同。
+    batch.clear();
+    mids.clear();
+    while (int(batch.size()) < std::max(mConcurrency, 1) && heap.size() > 1) {
+      auto top = heap[1];
+      if (hist[top.mR].first - hist[top.mL].first <= 1)
+        break;
+      heap.heap_pop();
+      batch.push_back(top);
+      mids.push_back((hist[top.mL].first + hist[top.mR].first) / 2);
+    }
+    if (batch.empty())
+      break;
 
-    heap.heap_push({ lftIndex, midIndex });
-    heap.heap_push({ midIndex, rhtIndex });
+    std::size_t midIndex = mseHist->size();
+    evaluate(mids);
 
-    auto top = heap.heap_pop();
-    lftIndex = top.mL, rhtIndex = top.mR;
+    for (auto& ent : batch) {
+      heap.heap_push({ ent.mL, midIndex });
+      heap.heap_push({ midIndex, ent.mR });
+      ++midIndex;
+    }
 
     time("LogMeans-iter");
   }
 
-  *ansIndex = rhtIndex;
+  *ansIndex = heap[1].mR;
 }
 
 void
-LogMeans::binary_search(const DataSet& data,
+LogMeans::binary_search(const DataView& data,
                         Catalog* cata,
                         MseHistory* mseHist,
                         std::size_t* ansIndex,
                         int minK,
                         int maxK)
+{
+  bisect(data, cata, mseHist, ansIndex, minK, maxK);
+}
+
+void
+LogMeans::binary_search(const F64DataView& data,
+                        Catalog* cata,
+                        F64MseHistory* mseHist,
+                        std::size_t* ansIndex,
+                        int minK,
+                        int maxK)
+{
+  bisect(data, cata, mseHist, ansIndex, minK, maxK);
+}
+
+template<typename Code>
+void
+LogMeans::binary_search(const Quantized<Code>& data,
+                        Catalog* cata,
+                        MseHistory* mseHist,
+                        std::size_t* ansIndex,
+                        int minK,
+                        int maxK)
+{
+  bisect(data, cata, mseHist, ansIndex, minK, maxK);
+}
+
+template<typename Data>
+void
+LogMeans::bisect(const Data& data,
+                 Catalog* cata,
+                 History<Data>* mseHist,
+                 std::size_t* ansIndex,
+                 int minK,
+                 int maxK)
 {
   Profiler::Scope scopeProf(*this, "LogMeans.bs");
 
   mseHist->clear();
+  mWarm.clear();
 
   int lft = minK, rht = maxK;
   double lftMse, rhtMse;
 
-  mKMeans(data, lft, cata, &lftMse);
+  kmeans(data, lft, cata, &lftMse);
   mseHist->emplace_back(lft, lftMse);
 
-  mKMeans(data, rht, cata, &rhtMse);
+  kmeans(data, rht, cata, &rhtMse);
   mseHist->emplace_back(rht, rhtMse);
 
   while (rht - lft > 1) {
     auto mid = (lft + rht) / 2;
     double midMse;
 
-    mKMeans(data, mid, cata, &midMse);
+    kmeans(data, mid, cata, &midMse);
     mseHist->emplace_back(mid, midMse);
 
     if (lftMse / midMse > midMse / rhtMse)
@@ -245,10 +229,84 @@ LogMeans::binary_search(const DataSet& data,
   *ansIndex = mseHist->size() - 1;
 }
 
+template<typename Data>
+void
+LogMeans::evaluate(const Data& data,
+                   const std::vector<int>& ks,
+                   Catalog* cata,
+                   History<Data>* mseHist)
+{
+  int n = ks.size();
+  int threads = omp_get_max_threads();
+  int outer = std::min({ n, threads, std::max(mConcurrency, 1) });
+  std::vector<double> mses(n);
+
+  if (outer == 1) {
+    for (int i = 0; i < n; ++i)
+      kmeans(data, ks[i], cata, &mses[i]);
+  }
+
+  else {
+    // 将线程预算分给同时进行的各个 KMeans，需要允许嵌套并行
+    std::vector<Catalog> catas(n);
+    int levels = omp_get_max_active_levels();
+    omp_set_max_active_levels(2);
+
+#pragma omp parallel for num_threads(outer) schedule(dynamic, 1)
+    for (int i = 0; i < n; ++i) {
+      int tid = omp_get_thread_num();
+      omp_set_num_threads(threads * (tid + 1) / outer - threads * tid / outer);
+      kmeans(data, ks[i], &catas[i], &mses[i]);
+    }
+
+    omp_set_max_active_levels(levels);
+    *cata = std::move(catas.back());
+  }
+
+  for (int i = 0; i < n; ++i)
+    mseHist->emplace_back(ks[i], mses[i]);
+}
+
+template<typename Data>
+void
+LogMeans::kmeans(const Data& data, int k, Catalog* cata, double* mse)
+{
+  if (mWarmStart)
+    mWarm(mKMeans, data, k, cata, mse);
+  else
+    mKMeans(data, k, cata, mse);
+}
+
 void
 LogMeans::KMeans::report(Profiler::Entry& entry) noexcept
 {
   mSelf.report(entry);
 }
 
+void
+LogMeans::StreamKMeans::report(Profiler::Entry& entry) noexcept
+{
+  mSelf.report(entry);
+}
+
+#define LIB_INSTANTIATE(Code)                                                  \
+  template void LogMeans::operator()(const Quantized<Code>&,                   \
+                                     Catalog*,                                 \
+                                     MseHistory*,                              \
+                                     std::size_t*,                             \
+                                     int,                                      \
+                                     int);                                     \
+  template void LogMeans::binary_search(const Quantized<Code>&,                \
+                                        Catalog*,                              \
+                                        MseHistory*,                           \
+                                        std::size_t*,                          \
+                                        int,                                   \
+                                        int);
+
+LIB_INSTANTIATE(std::int8_t)
+LIB_INSTANTIATE(Eigen::half)
+LIB_INSTANTIATE(Eigen::bfloat16)
+
+#undef LIB_INSTANTIATE
+
 } // namespace Lib
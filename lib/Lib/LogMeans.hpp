@@ -2,12 +2,19 @@
 
 #include "Lib/KMeans.hpp"
 #include "Profiler.hpp"
+#include "StreamKMeans.hpp"
+#include "WarmStart.hpp"
 #include "lib.hpp"
+#include <functional>
 
 namespace Lib {
 
 class LogMeans : public Profiler
 {
+public:
+  bool mWarmStart{ false }; ///< 是否用相邻聚类数的结果热启动 KMeans
+  int mConcurrency{ 1 };    ///< 同时评估的区间数，线程数在其间平分
+
 public:
   /**
    * @param[in] data 数据集
@@ -17,24 +24,147 @@ public:
    * @param[in] minK 最小聚类数
    * @param[in] maxK 最大聚类数
    */
-  void operator()(const DataSet& data,
+  void operator()(const DataView& data,
                   Catalog* cata,
                   MseHistory* mseHist,
                   std::size_t* ansIndex,
                   int minK,
                   int maxK);
 
+  /**
+   * @brief double 精度版。
+   */
+  void operator()(const F64DataView& data,
+                  Catalog* cata,
+                  F64MseHistory* mseHist,
+                  std::size_t* ansIndex,
+                  int minK,
+                  int maxK);
+
+  /**
+   * @brief 量化数据集版。
+   */
+  template<typename Code>
+  void operator()(const Quantized<Code>& data,
+                  Catalog* cata,
+                  MseHistory* mseHist,
+                  std::size_t* ansIndex,
+                  int minK,
+                  int maxK);
+
+  /**
+   * @brief 外存版，用 StreamKMeans 逐块扫描数据集文件，数据集不必装入内存。
+   *
+   * @param[in] dataPath 数据集文件路径
+   * @param[in] cataPath 聚类结果文件路径，为空时不输出，否则在搜索结束后
+   * 以最终的聚类数再聚类一次并输出
+   * @param[out] mseHist 误差历史
+   * @param[out] ansIndex 最终结果在 \p mseHist 中的索引
+   * @param[in] minK 最小聚类数
+   * @param[in] maxK 最大聚类数
+   */
+  void operator()(const char* dataPath,
+                  const char* cataPath,
+                  MseHistory* mseHist,
+                  std::size_t* ansIndex,
+                  int minK,
+                  int maxK);
+
   /**
    * @brief 二分查找版
    */
-  void binary_search(const DataSet& data,
+  void binary_search(const DataView& data,
+                     Catalog* cata,
+                     MseHistory* mseHist,
+                     std::size_t* ansIndex,
+                     int minK,
+                     int maxK);
+
+  /**
+   * @brief double 精度的二分查找版。
+   */
+  void binary_search(const F64DataView& data,
+                     Catalog* cata,
+                     F64MseHistory* mseHist,
+                     std::size_t* ansIndex,
+                     int minK,
+                     int maxK);
+
+  /**
+   * @brief 量化数据集的二分查找版。
+   */
+  template<typename Code>
+  void binary_search(const Quantized<Code>& data,
                      Catalog* cata,
                      MseHistory* mseHist,
                      std::size_t* ansIndex,
                      int minK,
                      int maxK);
 
+  /**
+   * @brief 获取内部使用的 KMeans 对象，用于配置其参数。
+   *
+   * 默认使用 k-means++ 初始化，以减少每个聚类数上的迭代次数。
+   */
+  Lib::KMeans& get_kmeans() noexcept { return mKMeans; }
+
+  /**
+   * @brief 获取外存版内部使用的 StreamKMeans 对象，用于配置其参数。
+   */
+  Lib::StreamKMeans& get_stream_kmeans() noexcept { return mStream; }
+
 private:
+  WarmStart mWarm;
+
+  /**
+   * @brief 数据集 Data 上的误差历史，精度与数据集（解码后）相同。
+   */
+  template<typename Data>
+  using History = BasicMseHistory<typename Data::Scalar>;
+
+  template<typename Data>
+  void run(const Data& data,
+           Catalog* cata,
+           History<Data>* mseHist,
+           std::size_t* ansIndex,
+           int minK,
+           int maxK);
+
+  template<typename Data>
+  void bisect(const Data& data,
+              Catalog* cata,
+              History<Data>* mseHist,
+              std::size_t* ansIndex,
+              int minK,
+              int maxK);
+
+  /**
+   * @brief 搜索过程，\p evaluate 对给定的各聚类数求误差并按顺序追加到
+   * \p mseHist 中。
+   */
+  template<typename _Scalar>
+  void search(const std::function<void(const std::vector<int>&)>& evaluate,
+              BasicMseHistory<_Scalar>* mseHist,
+              std::size_t* ansIndex,
+              int minK,
+              int maxK);
+
+  /**
+   * @brief 对聚类数 k 运行一次 KMeans，按 mWarmStart 决定是否热启动。
+   */
+  template<typename Data>
+  void kmeans(const Data& data, int k, Catalog* cata, double* mse);
+
+  /**
+   * @brief 并发地对 ks 中的每个聚类数运行 KMeans，按顺序将结果追加到
+   * \p mseHist 中，\p cata 为最后一个聚类数的结果。
+   */
+  template<typename Data>
+  void evaluate(const Data& data,
+                const std::vector<int>& ks,
+                Catalog* cata,
+                History<Data>* mseHist);
+
   class KMeans : public Lib::KMeans
   {
     LogMeans& mSelf;
@@ -44,10 +174,25 @@ private:
       : Lib::KMeans(self)
       , mSelf(self)
     {
+      mInit = Init::kPlusPlus;
     }
 
     void report(Profiler::Entry& entry) noexcept override;
   } mKMeans{ *this };
+
+  class StreamKMeans : public Lib::StreamKMeans
+  {
+    LogMeans& mSelf;
+
+  public:
+    StreamKMeans(LogMeans& self)
+      : Lib::StreamKMeans(self)
+      , mSelf(self)
+    {
+    }
+
+    void report(Profiler::Entry& entry) noexcept override;
+  } mStream{ *this };
 };
 
 } // namespace Lib
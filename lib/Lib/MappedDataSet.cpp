@@ -0,0 +1,63 @@
+#include "MappedDataSet.hpp"
+#include <utility>
+
+namespace Lib {
+
+template<typename _Scalar>
+BasicMappedDataSet<_Scalar>::BasicMappedDataSet(
+  BasicMappedDataSet&& other) noexcept
+{
+  *this = std::move(other);
+}
+
+template<typename _Scalar>
+BasicMappedDataSet<_Scalar>&
+BasicMappedDataSet<_Scalar>::operator=(BasicMappedDataSet&& other) noexcept
+{
+  if (this != &other) {
+    close();
+    std::swap(mFile, other.mFile);
+    std::swap(mData, other.mData);
+    std::swap(mRows, other.mRows);
+    std::swap(mCols, other.mCols);
+  }
+  return *this;
+}
+
+template<typename _Scalar>
+void
+BasicMappedDataSet<_Scalar>::open(const char* path) noexcept(false)
+{
+  close();
+
+  auto header = MatxHeader::peek(path);
+  if (!header.holds<_Scalar>())
+    throw err::Lit("mismatched matx dtype.");
+  if (!header.native())
+    throw err::Lit("non-native matx layout.");
+
+  mFile.open(path);
+
+  // 数据从 offset() 开始按列连续存储，分块表只用于定位
+  mRows = header.mRows, mCols = header.mCols;
+  if (mFile.size() !=
+      header.offset() + sizeof(_Scalar) * std::size_t(mRows) * mCols) {
+    close();
+    throw err::Lit("incorrect data length for matx file.");
+  }
+  mData = reinterpret_cast<const _Scalar*>(mFile.data() + header.offset());
+}
+
+template<typename _Scalar>
+void
+BasicMappedDataSet<_Scalar>::close() noexcept
+{
+  mFile.close();
+  mData = nullptr;
+  mRows = mCols = 0;
+}
+
+template class BasicMappedDataSet<float>;
+template class BasicMappedDataSet<double>;
+
+} // namespace Lib
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "MappedFile.hpp"
+#include "lib.hpp"
+
+namespace Lib {
+
+/**
+ * @brief 内存映射的只读数据集。
+ *
+ * 将二进制格式（见 matx_dump_bin）的数据集文件映射到内存，数据部分直接作为
+ * Eigen 矩阵使用，不经过拷贝，由操作系统按需分页读入。文件的元素类型须与
+ * _Scalar 一致。
+ */
+template<typename _Scalar>
+class BasicMappedDataSet
+{
+public:
+  using Advice = MappedFile::Advice;
+
+public:
+  BasicMappedDataSet() noexcept = default;
+
+  /**
+   * @param path 文件路径
+   */
+  explicit BasicMappedDataSet(const char* path) noexcept(false) { open(path); }
+
+  BasicMappedDataSet(const BasicMappedDataSet&) = delete;
+  BasicMappedDataSet& operator=(const BasicMappedDataSet&) = delete;
+
+  BasicMappedDataSet(BasicMappedDataSet&& other) noexcept;
+  BasicMappedDataSet& operator=(BasicMappedDataSet&& other) noexcept;
+
+  ~BasicMappedDataSet() noexcept { close(); }
+
+public:
+  operator bool() const noexcept { return mFile; }
+
+  /**
+   * @brief 以数据集视图的形式使用，不拷贝数据。
+   */
+  operator BasicDataView<_Scalar>() const noexcept { return map(); }
+
+public:
+  /**
+   * @brief 打开并映射文件，之前映射的文件会被关闭。
+   */
+  void open(const char* path) noexcept(false);
+
+  /**
+   * @brief 解除映射并关闭文件。
+   */
+  void close() noexcept;
+
+  /**
+   * @brief 向操作系统提示接下来的访问模式。
+   */
+  void advise(Advice advice) const noexcept(false) { mFile.advise(advice); }
+
+  /**
+   * @brief 获取映射的矩阵。
+   */
+  Eigen::Map<const BasicDataSet<_Scalar>> map() const noexcept
+  {
+    return { mData, mRows, mCols };
+  }
+
+  Eigen::Index rows() const noexcept { return mRows; }
+
+  Eigen::Index cols() const noexcept { return mCols; }
+
+private:
+  MappedFile mFile;
+  const _Scalar* mData{ nullptr };
+  Eigen::Index mRows{ 0 }, mCols{ 0 };
+};
+
+using MappedDataSet = BasicMappedDataSet<float>;
+using F64MappedDataSet = BasicMappedDataSet<double>;
+
+extern template class BasicMappedDataSet<float>;
+extern template class BasicMappedDataSet<double>;
+
+} // namespace Lib
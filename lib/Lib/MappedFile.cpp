@@ -0,0 +1,151 @@
+#include "MappedFile.hpp"
+#include <utility>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace Lib {
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+{
+  *this = std::move(other);
+}
+
+MappedFile&
+MappedFile::operator=(MappedFile&& other) noexcept
+{
+  if (this != &other) {
+    close();
+    std::swap(mBase, other.mBase);
+    std::swap(mLength, other.mLength);
+#ifdef _WIN32
+    std::swap(mFile, other.mFile);
+    std::swap(mMapping, other.mMapping);
+#endif
+  }
+  return *this;
+}
+
+void
+MappedFile::open(const char* path) noexcept(false)
+{
+  close();
+
+#ifdef _WIN32
+  mFile = CreateFileA(path,
+                      GENERIC_READ,
+                      FILE_SHARE_READ,
+                      nullptr,
+                      OPEN_EXISTING,
+                      FILE_ATTRIBUTE_NORMAL,
+                      nullptr);
+  if (mFile == INVALID_HANDLE_VALUE) {
+    mFile = nullptr;
+    throw err::Win32(GetLastError());
+  }
+
+  LARGE_INTEGER size;
+  GetFileSizeEx(mFile, &size);
+  mLength = size.QuadPart;
+
+  mMapping = CreateFileMappingA(mFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (mMapping == nullptr) {
+    auto code = GetLastError();
+    close();
+    throw err::Win32(code);
+  }
+
+  mBase = MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0);
+  if (mBase == nullptr) {
+    auto code = GetLastError();
+    close();
+    throw err::Win32(code);
+  }
+#else
+  int fd = ::open(path, O_RDONLY);
+  if (fd == -1)
+    throw err::Errno(errno);
+
+  struct stat st;
+  if (fstat(fd, &st) == -1) {
+    auto code = errno;
+    ::close(fd);
+    throw err::Errno(code);
+  }
+  mLength = st.st_size;
+
+  // 映射建立后即可关闭文件描述符
+  auto* base = mmap(nullptr, mLength, PROT_READ, MAP_SHARED, fd, 0);
+  auto code = errno;
+  ::close(fd);
+  if (base == MAP_FAILED) {
+    mLength = 0;
+    throw err::Errno(code);
+  }
+  mBase = base;
+#endif
+}
+
+void
+MappedFile::close() noexcept
+{
+#ifdef _WIN32
+  if (mBase)
+    UnmapViewOfFile(mBase);
+  if (mMapping)
+    CloseHandle(mMapping);
+  if (mFile)
+    CloseHandle(mFile);
+  mFile = mMapping = nullptr;
+#else
+  if (mBase)
+    munmap(mBase, mLength);
+#endif
+
+  mBase = nullptr;
+  mLength = 0;
+}
+
+void
+MappedFile::advise(Advice advice) const noexcept(false)
+{
+  if (!mBase)
+    return;
+
+#ifdef _WIN32
+  if (advice == Advice::kWillNeed) {
+    WIN32_MEMORY_RANGE_ENTRY range{ mBase, mLength };
+    PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+  }
+#else
+  int flag = MADV_NORMAL;
+  switch (advice) {
+    case Advice::kNormal:
+      flag = MADV_NORMAL;
+      break;
+
+    case Advice::kSequential:
+      flag = MADV_SEQUENTIAL;
+      break;
+
+    case Advice::kRandom:
+      flag = MADV_RANDOM;
+      break;
+
+    case Advice::kWillNeed:
+      flag = MADV_WILLNEED;
+      break;
+  }
+
+  if (madvise(mBase, mLength, flag) == -1)
+    throw err::Errno(errno);
+#endif
+}
+
+} // namespace Lib
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "err.hpp"
+#include <cstddef>
+
+namespace Lib {
+
+/**
+ * @brief 只读内存映射的文件。
+ */
+class MappedFile
+{
+public:
+  /**
+   * @brief 访问模式提示，用于指导操作系统的预读策略。
+   */
+  enum class Advice
+  {
+    kNormal,     ///< 默认
+    kSequential, ///< 顺序访问，积极预读，如 Lloyd 迭代的全量扫描
+    kRandom,     ///< 随机访问，不预读，如小批量采样
+    kWillNeed,   ///< 即将访问，立即开始预读全部数据
+  };
+
+public:
+  MappedFile() noexcept = default;
+
+  /**
+   * @param path 文件路径
+   */
+  explicit MappedFile(const char* path) noexcept(false) { open(path); }
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  MappedFile(MappedFile&& other) noexcept;
+  MappedFile& operator=(MappedFile&& other) noexcept;
+
+  ~MappedFile() noexcept { close(); }
+
+public:
+  operator bool() const noexcept { return mBase != nullptr; }
+
+public:
+  /**
+   * @brief 打开并映射整个文件，之前映射的文件会被关闭。
+   */
+  void open(const char* path) noexcept(false);
+
+  /**
+   * @brief 解除映射并关闭文件。
+   */
+  void close() noexcept;
+
+  /**
+   * @brief 向操作系统提示接下来的访问模式。
+   */
+  void advise(Advice advice) const noexcept(false);
+
+  const char* data() const noexcept { return static_cast<const char*>(mBase); }
+
+  std::size_t size() const noexcept { return mLength; }
+
+private:
+  void* mBase{ nullptr };   ///< 映射区域的起始地址
+  std::size_t mLength{ 0 }; ///< 映射区域的长度
+
+#ifdef _WIN32
+  void* mFile{ nullptr };    ///< 文件句柄
+  void* mMapping{ nullptr }; ///< 映射对象句柄
+#endif
+};
+
+} // namespace Lib
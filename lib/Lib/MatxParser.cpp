@@ -0,0 +1,429 @@
+#include "MatxParser.hpp"
+#include "CFile64.hpp"
+#include <algorithm>
+#include <boost/json/basic_parser_impl.hpp>
+#include <charconv>
+#include <omp.h>
+
+namespace Lib {
+
+namespace {
+
+using Scalar = DataSet::value_type;
+
+bool
+is_space(char c)
+{
+  return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+/**
+ * @brief 将数字序列 [begin, end) 在逗号处切为至多 n 段，返回各段的起点与
+ * end，除第一段外每段都以逗号开头。
+ */
+std::vector<const char*>
+split_at_commas(const char* begin, const char* end, int n)
+{
+  std::vector<const char*> cuts{ begin };
+  for (int i = 1; i < n; ++i) {
+    auto* p = std::max(cuts.back() + 1, begin + (end - begin) * i / n);
+    if ((p = std::find(std::min(p, end), end, ',')) == end)
+      break;
+    cuts.push_back(p);
+  }
+  cuts.push_back(end);
+  return cuts;
+}
+
+/**
+ * @brief 并行数出 split_at_commas 切出的各段之前的逗号个数，最后一项为逗号
+ * 总数。
+ */
+std::vector<std::size_t>
+count_commas(const std::vector<const char*>& cuts)
+{
+  int nChunks = cuts.size() - 1;
+  std::vector<std::size_t> firsts(nChunks + 1, 0);
+
+#pragma omp parallel for
+  for (int i = 0; i < nChunks; ++i)
+    firsts[i + 1] = std::count(cuts[i], cuts[i + 1], ',');
+  for (int i = 0; i < nChunks; ++i)
+    firsts[i + 1] += firsts[i];
+  return firsts;
+}
+
+/**
+ * @brief 并行解析各段中的数字，写入 out 中以 count_commas 的结果定位的位置。
+ *
+ * 数字按 double 解析后再转换，与逐个解析时的结果一致。
+ */
+void
+parse_numbers(const std::vector<const char*>& cuts,
+              const std::vector<std::size_t>& firsts,
+              Scalar* out) noexcept(false)
+{
+  int nChunks = cuts.size() - 1;
+  bool bad = false;
+
+#pragma omp parallel for schedule(dynamic) reduction(|| : bad)
+  for (int i = 0; i < nChunks; ++i) {
+    // 除第一段外，段首的逗号结束的是上一段的最后一个数字
+    auto *p = cuts[i] + (i != 0), *end = cuts[i + 1];
+    auto* q = out + firsts[i] + (i != 0);
+    while (!bad) {
+      while (p != end && is_space(*p))
+        ++p;
+      if (p == end)
+        break; // 末尾的逗号，已在切分前检查过
+
+      double d;
+      auto [ptr, ec] = std::from_chars(p, end, d);
+      if (ec != std::errc() || ptr == p) {
+        bad = true;
+        break;
+      }
+      *q++ = static_cast<Scalar>(d);
+
+      for (p = ptr; p != end && is_space(*p);)
+        ++p;
+      if (p == end)
+        break;
+      if (*p++ != ',')
+        bad = true;
+    }
+  }
+
+  if (bad)
+    throw err::Lit("invalid number in JSON matrix.");
+}
+
+/**
+ * @brief bj::basic_parser 的处理器，矩阵以外的部分交给 bj::value_stack。
+ */
+class Handler
+{
+public:
+  static constexpr std::size_t max_object_size = -1;
+  static constexpr std::size_t max_array_size = -1;
+  static constexpr std::size_t max_key_size = -1;
+  static constexpr std::size_t max_string_size = -1;
+
+public:
+  bj::value_stack mStack;
+  const char* mDataBegin{ nullptr }; ///< 暂停时 data 数组第一个数字的位置
+  const char* mDataEnd{ nullptr };   ///< 暂停时 data 数组的 ']' 的位置
+
+public:
+  /**
+   * @param end 整个文本的末尾，用于在暂停前查找 data 数组的结尾
+   */
+  Handler(std::string_view key,
+          DataSet* matx,
+          const char* end,
+          std::size_t parallelBytes)
+    : mKey(key)
+    , mMatx(matx)
+    , mEnd(end)
+    , mParallelBytes(parallelBytes)
+  {
+  }
+
+public:
+  /**
+   * @brief 并行解析暂停处的 data 数组。
+   */
+  void parse_data(bool allowTrailingCommas) noexcept(false)
+  {
+    auto* last = mDataEnd;
+    while (is_space(last[-1]))
+      --last;
+    bool trailing = last[-1] == ',';
+    if (trailing && !allowTrailingCommas)
+      throw err::Lit("invalid number in JSON matrix.");
+
+    auto cuts = split_at_commas(mDataBegin, last, 4 * omp_get_max_threads());
+    auto firsts = count_commas(cuts);
+    std::size_t n = firsts.back() + !trailing;
+
+    if (mOut == nullptr) {
+      mPending.resize(n);
+      mOut = mPending.data();
+    } else if (n != mCapacity)
+      throw err::Lit("incorrect data length for JSON matrix.");
+    parse_numbers(cuts, firsts, mOut);
+
+    mCount = n;
+    mDataDone = true;
+    mEnd = nullptr;
+  }
+
+public:
+  ///@name basic_parser handler
+  ///@{
+  bool on_document_begin(bj::error_code&)
+  {
+    mStack.reset();
+    mDepth = 0;
+    mInMatx = mInData = false;
+    return true;
+  }
+
+  bool on_document_end(bj::error_code&) { return true; }
+
+  bool on_object_begin(bj::error_code&)
+  {
+    check_in_data();
+    if (++mDepth == 2 && mTopKey == mKey) {
+      mInMatx = true;
+      mRows = mCols = -1;
+    }
+    return true;
+  }
+
+  bool on_object_end(std::size_t n, bj::error_code&)
+  {
+    if (mDepth-- == 2 && mInMatx) {
+      mInMatx = false;
+      finish();
+    }
+    mStack.push_object(n);
+    return true;
+  }
+
+  bool on_array_begin(bj::error_code&)
+  {
+    check_in_data();
+    if (++mDepth == 3 && mInMatx && mMatxKey == "data" && !mDataDone) {
+      mInData = true;
+      mCount = 0;
+      if (mRows >= 0 && mCols >= 0) {
+        mMatx->resize(mRows, mCols);
+        mOut = mMatx->data();
+        mCapacity = mMatx->size();
+      }
+    }
+    return true;
+  }
+
+  bool on_array_end(std::size_t n, bj::error_code&)
+  {
+    --mDepth;
+    if (mInData) {
+      mInData = false;
+      mDataDone = true;
+      n = 0;
+    }
+    mStack.push_array(n);
+    return true;
+  }
+
+  bool on_key_part(bj::string_view s, std::size_t, bj::error_code&)
+  {
+    mKeyBuf.append(s.data(), s.size());
+    mStack.push_chars(s);
+    return true;
+  }
+
+  bool on_key(bj::string_view s, std::size_t, bj::error_code&)
+  {
+    mKeyBuf.append(s.data(), s.size());
+    if (mDepth == 1)
+      mTopKey = mKeyBuf;
+    else if (mDepth == 2)
+      mMatxKey = mKeyBuf;
+    mKeyBuf.clear();
+    mStack.push_key(s);
+    return true;
+  }
+
+  bool on_string_part(bj::string_view s, std::size_t, bj::error_code&)
+  {
+    check_in_data();
+    mStack.push_chars(s);
+    return true;
+  }
+
+  bool on_string(bj::string_view s, std::size_t, bj::error_code&)
+  {
+    check_in_data();
+    mStack.push_string(s);
+    return true;
+  }
+
+  bool on_number_part(bj::string_view, bj::error_code&)
+  {
+    mNumberPart = true;
+    return true;
+  }
+
+  bool on_int64(std::int64_t i, bj::string_view s, bj::error_code& ec)
+  {
+    if (mInData)
+      return store(i, s, ec);
+    if (mInMatx && mDepth == 2)
+      shape(i);
+    mStack.push_int64(i);
+    return true;
+  }
+
+  bool on_uint64(std::uint64_t u, bj::string_view s, bj::error_code& ec)
+  {
+    if (mInData)
+      return store(u, s, ec);
+    mStack.push_uint64(u);
+    return true;
+  }
+
+  bool on_double(double d, bj::string_view s, bj::error_code& ec)
+  {
+    if (mInData)
+      return store(d, s, ec);
+    mStack.push_double(d);
+    return true;
+  }
+
+  bool on_bool(bool b, bj::error_code&)
+  {
+    check_in_data();
+    mStack.push_bool(b);
+    return true;
+  }
+
+  bool on_null(bj::error_code&)
+  {
+    check_in_data();
+    mStack.push_null();
+    return true;
+  }
+
+  bool on_comment_part(bj::string_view, bj::error_code&) { return true; }
+
+  bool on_comment(bj::string_view, bj::error_code&) { return true; }
+  ///@}
+
+private:
+  std::string_view mKey;
+  DataSet* mMatx;
+  const char* mEnd; ///< 文本末尾，不再允许暂停时为空
+  std::size_t mParallelBytes;
+
+  int mDepth{ 0 };
+  std::string mKeyBuf;  ///< 分段到达的键
+  std::string mTopKey;  ///< 顶层对象中最近的键
+  std::string mMatxKey; ///< 矩阵对象中最近的键
+
+  bool mInMatx{ false }, mInData{ false }, mDataDone{ false };
+  bool mNumberPart{ false }; ///< 当前数字是否分段到达
+  std::int64_t mRows{ -1 }, mCols{ -1 };
+
+  Scalar* mOut{ nullptr };      ///< 写入位置，形状未知时指向 mPending
+  std::size_t mCapacity{ 0 };   ///< mOut 的容量，仅在指向矩阵时有效
+  std::size_t mCount{ 0 };      ///< 已解析的数字个数
+  std::vector<Scalar> mPending; ///< rows 与 cols 未知时暂存的数据
+
+private:
+  void check_in_data() noexcept(false)
+  {
+    if (mInData)
+      throw err::Lit("invalid number in JSON matrix.");
+  }
+
+  void shape(std::int64_t i)
+  {
+    if (mMatxKey == "rows")
+      mRows = i;
+    else if (mMatxKey == "cols")
+      mCols = i;
+  }
+
+  template<typename T>
+  bool store(T t, bj::string_view s, bj::error_code& ec) noexcept(false)
+  {
+    if (mCount == 0 && !mNumberPart && mEnd != nullptr) {
+      auto* close = std::find(s.data(), mEnd, ']');
+      if (close != mEnd && std::size_t(close - s.data()) >= mParallelBytes &&
+          std::find(s.data(), close, '/') == close) {
+        mDataBegin = s.data();
+        mDataEnd = close;
+        ec = boost::system::errc::make_error_code(
+          boost::system::errc::operation_canceled);
+        return false;
+      }
+    }
+    mNumberPart = false;
+
+    if (mOut == nullptr)
+      mPending.push_back(static_cast<Scalar>(t));
+    else if (mCount < mCapacity)
+      mOut[mCount] = static_cast<Scalar>(t);
+    ++mCount;
+    return true;
+  }
+
+  /**
+   * @brief 矩阵对象结束，检查形状并移入暂存的数据。
+   */
+  void finish() noexcept(false)
+  {
+    if (mRows < 0 || mCols < 0)
+      throw err::Lit("incorrect data length for JSON matrix.");
+
+    if (mOut == nullptr || mOut == mPending.data()) {
+      mMatx->resize(mRows, mCols);
+      if (mCount != mMatx->size())
+        throw err::Lit("incorrect data length for JSON matrix.");
+      std::copy_n(mPending.data(), mCount, mMatx->data());
+      mPending = {};
+    } else if (mCount != mCapacity)
+      throw err::Lit("incorrect data length for JSON matrix.");
+  }
+};
+
+} // namespace
+
+bj::value
+MatxParser::operator()(std::string_view text,
+                       std::string_view key,
+                       DataSet* matx) const noexcept(false)
+{
+  auto *begin = text.data(), *end = begin + text.size();
+  bj::basic_parser<Handler> parser(mOptions, key, matx, end, mParallelBytes);
+  auto& handler = parser.handler();
+
+  bj::error_code ec;
+  parser.write_some(false, begin, text.size(), ec);
+
+  // 在 data 数组处暂停了：并行解析数组，再让解析器看到一个空数组
+  if (ec && handler.mDataBegin != nullptr) {
+    handler.parse_data(mOptions.allow_trailing_commas);
+    parser.reset();
+    ec = {};
+    parser.write_some(true, begin, handler.mDataBegin - begin, ec);
+    if (!ec)
+      parser.write_some(
+        false, handler.mDataEnd, end - handler.mDataEnd, ec);
+  }
+
+  if (ec)
+    throw err::Str("invalid JSON: " + ec.message());
+  return handler.mStack.release();
+}
+
+bj::value
+MatxParser::load(const char* path,
+                 std::string_view key,
+                 DataSet* matx) const noexcept(false)
+{
+  CFile64 file(path, "rb");
+  CFile64::Closer closer(file);
+
+  file.seek(0, SEEK_END);
+  std::string text(file.tell(), '\0');
+  file.rewind();
+  file.read(text.data(), 1, text.size());
+
+  return (*this)(text, key, matx);
+}
+
+} // namespace Lib
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "lib.hpp"
+#include <string_view>
+
+namespace Lib {
+
+/**
+ * @brief 流式解析内联了矩阵的 JSON 文档。
+ *
+ * 基于 bj::basic_parser，顶层对象中键为 key 的对象按 matx_to_json 的格式视为
+ * 矩阵，其 data 数组中的数字直接写入预先分配的矩阵，不经过 bj::value，其余
+ * 部分照常解析为 bj::value。rows 与 cols 在 data 之前出现时按其分配矩阵，否则
+ * 先暂存在数组中。
+ *
+ * data 数组的字节数达到 mParallelBytes 时，解析器在第一个数字处暂停，数组在
+ * 逗号处切为若干段，由多个线程用 std::from_chars 并行解析，之后解析器从数组
+ * 末尾继续。
+ */
+class MatxParser
+{
+public:
+  bj::parse_options mOptions;            ///< 解析选项
+  std::size_t mParallelBytes{ 1 << 20 }; ///< 并行解析 data 数组的字节数下限
+
+public:
+  /**
+   * @brief 解析 JSON 文本。
+   *
+   * @param[in] text JSON 文本
+   * @param[in] key 矩阵在顶层对象中的键
+   * @param[out] matx 矩阵，key 对应的值不是对象时不变
+   * @return 文档的其余部分，矩阵的 data 在其中为空数组
+   */
+  bj::value operator()(std::string_view text,
+                       std::string_view key,
+                       DataSet* matx) const noexcept(false);
+
+  /**
+   * @brief 读入并解析 JSON 文件 path。
+   */
+  bj::value load(const char* path,
+                 std::string_view key,
+                 DataSet* matx) const noexcept(false);
+};
+
+} // namespace Lib
@@ -0,0 +1,129 @@
+#include "PerfCounters.hpp"
+
+#ifdef __linux__
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace Lib {
+
+const char* const PerfCounters::kNames[kEvents] = {
+  "cycles",
+  "instructions",
+  "llc-misses",
+  "branch-misses",
+};
+
+PerfCounters::Sample
+PerfCounters::Sample::operator-(const Sample& other) const noexcept
+{
+  Sample ret;
+  ret.mValid = mValid & other.mValid;
+  for (int i = 0; i < kEvents; ++i) {
+    if (ret.has(i))
+      ret.mValues[i] = mValues[i] - other.mValues[i];
+  }
+  return ret;
+}
+
+PerfCounters&
+PerfCounters::local() noexcept
+{
+  static thread_local PerfCounters stCounters;
+  return stCounters;
+}
+
+#ifdef __linux__
+
+PerfCounters::PerfCounters() noexcept
+{
+  static const std::uint64_t kConfigs[kEvents] = {
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_MISSES,
+    PERF_COUNT_HW_BRANCH_MISSES,
+  };
+
+  for (int i = 0; i < kEvents; ++i) {
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = kConfigs[i];
+    attr.disabled = mLeader == -1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+                       PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    // 只统计当前线程，可在任意 CPU 上运行
+    mFds[i] = syscall(SYS_perf_event_open, &attr, 0, -1, mLeader, 0);
+    if (mFds[i] == -1)
+      continue;
+    if (mLeader == -1)
+      mLeader = mFds[i];
+    mValid |= 1 << i;
+    ++mCount;
+  }
+
+  if (mLeader != -1 &&
+      ioctl(mLeader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP) == -1) {
+    for (int i = 0; i < kEvents; ++i) {
+      if (mValid >> i & 1)
+        close(mFds[i]);
+    }
+    mLeader = -1;
+    mValid = mCount = 0;
+  }
+}
+
+PerfCounters::~PerfCounters() noexcept
+{
+  for (int i = 0; i < kEvents; ++i) {
+    if (mValid >> i & 1)
+      close(mFds[i]);
+  }
+}
+
+PerfCounters::Sample
+PerfCounters::read() const noexcept
+{
+  Sample ret;
+  if (mLeader == -1)
+    return ret;
+
+  // 格式为 { nr, time_enabled, time_running, values[nr] }
+  std::uint64_t buf[3 + kEvents];
+  auto bytes = ::read(mLeader, buf, sizeof(buf));
+  if (bytes != std::int64_t(sizeof(std::uint64_t) * (3 + mCount)) ||
+      buf[2] == 0)
+    return ret;
+
+  double scale = double(buf[1]) / buf[2];
+  const auto* value = buf + 3;
+  for (int i = 0; i < kEvents; ++i) {
+    if (mValid >> i & 1)
+      ret.mValues[i] = *value++ * scale;
+  }
+  ret.mValid = mValid;
+  return ret;
+}
+
+#else
+
+PerfCounters::PerfCounters() noexcept {}
+
+PerfCounters::~PerfCounters() noexcept {}
+
+PerfCounters::Sample
+PerfCounters::read() const noexcept
+{
+  return {};
+}
+
+#endif
+
+} // namespace Lib
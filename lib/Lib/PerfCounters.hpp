@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstdint>
+
+namespace Lib {
+
+/**
+ * @brief 当前线程的硬件性能计数器，基于 Linux 的 perf_event_open。
+ *
+ * 周期数、指令数、末级缓存缺失数和分支预测失败数作为一组同时调度，一次
+ * read 读出，只统计用户态。计数器被复用时按实际运行时间比例放大读数。
+ *
+ * 不允许使用性能事件（如 perf_event_paranoid 过高、容器禁止该系统调用）
+ * 或者非 Linux 平台上不可用，读数为空；单个事件不被硬件支持时只缺少该项。
+ */
+class PerfCounters
+{
+public:
+  /**
+   * @brief 事件。
+   */
+  enum Event
+  {
+    kCycles,       ///< CPU 周期数
+    kInstructions, ///< 退休的指令数
+    kLlcMisses,    ///< 末级缓存缺失数
+    kBranchMisses, ///< 分支预测失败数
+    kEvents,
+  };
+
+  static const char* const kNames[kEvents]; ///< 各事件在 JSON 中的名字
+
+  /**
+   * @brief 一次读数或者两次读数之差。
+   */
+  struct Sample
+  {
+    std::uint64_t mValues[kEvents]{};
+    std::uint8_t mValid{ 0 }; ///< 第 i 位表示第 i 个事件是否有效
+
+    explicit operator bool() const noexcept { return mValid != 0; }
+
+    bool has(int event) const noexcept { return mValid >> event & 1; }
+
+    /**
+     * @brief 两次读数之差，只保留两者都有效的事件。
+     */
+    Sample operator-(const Sample& other) const noexcept;
+  };
+
+public:
+  /**
+   * @brief 当前线程的计数器，首次调用时打开，线程退出时关闭。
+   */
+  static PerfCounters& local() noexcept;
+
+public:
+  /**
+   * @brief 为当前线程打开并启动计数器，失败时不可用而不抛出异常。
+   */
+  PerfCounters() noexcept;
+
+  PerfCounters(const PerfCounters&) = delete;
+  PerfCounters& operator=(const PerfCounters&) = delete;
+
+  ~PerfCounters() noexcept;
+
+public:
+  /**
+   * @brief 是否有可用的事件。
+   */
+  bool available() const noexcept { return mLeader != -1; }
+
+  /**
+   * @brief 读取各事件自打开以来的计数，不可用时为空。
+   */
+  Sample read() const noexcept;
+
+private:
+  int mFds[kEvents];        ///< 各事件的文件描述符，打开失败为 -1
+  int mLeader{ -1 };        ///< 组长的文件描述符
+  std::uint8_t mValid{ 0 }; ///< 打开成功的事件，顺序即组内顺序
+  std::uint8_t mCount{ 0 }; ///< 打开成功的事件数
+};
+
+} // namespace Lib
@@ -1,7 +1,15 @@
 #include "Profiler.hpp"
+#include <algorithm>
+#include <atomic>
 #include <boost/json.hpp>
 #include <cassert>
+#include <cmath>
+#include <deque>
 #include <iostream>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 
 std::ostream&
@@ -9,6 +17,17 @@ operator<<(std::ostream& out, const Lib::Profiler& prof)
 {
   using namespace Lib;
 
+  if (prof.mode() == Profiler::Mode::kAggregate) {
+    auto ns = [](std::uint64_t n) { return sc::nanoseconds(n); };
+    for (auto&& [tag, hist] : prof.histograms()) {
+      out << tag << " [" << hist.count() << "] min " << ns(hist.min())
+          << ", p50 " << ns(hist.percentile(0.5)) << ", p90 "
+          << ns(hist.percentile(0.9)) << ", p99 " << ns(hist.percentile(0.99))
+          << ", max " << ns(hist.max()) << '\n';
+    }
+    return out;
+  }
+
   std::vector<Profiler::Entry*> stack;
   auto last = prof.initial();
   for (auto&& i : prof) {
@@ -25,12 +44,10 @@ operator<<(std::ostream& out, const Lib::Profiler& prof)
       if (!stack.empty())
         out << '\t';
       out << i.mTag << " [" << (i.mTime - last) << ']';
-      if (i.mInfo) {
-        if (i.mInfo == &Profiler::Scope::gEnterInfo)
-          stack.push_back(&i);
-        else
-          out << " : " << i.mInfo->info();
-      }
+      if (i.mInfo == &Profiler::Scope::gEnterInfo)
+        stack.push_back(&i);
+      else if (i.has_info())
+        out << " : " << i.info();
       out << '\n';
     }
 
@@ -42,6 +59,372 @@ operator<<(std::ostream& out, const Lib::Profiler& prof)
 
 namespace Lib {
 
+namespace {
+
+/**
+ * @brief 将硬件计数器的有效读数导出为以事件名为键的对象。
+ */
+bj::object
+counters_to_json(const PerfCounters::Sample& sample)
+{
+  bj::object obj;
+  for (int i = 0; i < PerfCounters::kEvents; ++i) {
+    if (sample.has(i))
+      obj[PerfCounters::kNames[i]] = sample.mValues[i];
+  }
+  return obj;
+}
+
+PerfCounters::Sample
+counters_from_json(const bj::object& obj)
+{
+  PerfCounters::Sample sample;
+  for (int i = 0; i < PerfCounters::kEvents; ++i) {
+    auto it = obj.find(PerfCounters::kNames[i]);
+    if (it != obj.end()) {
+      sample.mValues[i] = it->value().to_number<std::uint64_t>();
+      sample.mValid |= 1 << i;
+    }
+  }
+  return sample;
+}
+
+} // namespace
+
+/**
+ * @brief 单个线程的记录条目区。
+ *
+ * 条目按块分配，块内顺序构造，地址在条目区销毁前不变。只有所属线程追加，
+ * mSize 以 release 语义发布，读者以 acquire 语义读到的条目都已构造完毕。
+ *
+ * 聚合模式下只在一个暂存位置构造条目，耗时计入按标签指针索引的直方图。
+ */
+class alignas(64) Profiler::Arena
+{
+public:
+  static constexpr std::size_t kChunkEntries = 256; ///< 每块的条目数
+
+public:
+  const std::thread::id mOwner; ///< 所属线程
+  const std::uint32_t mIndex;   ///< 线程编号，即 Entry::mThread
+
+public:
+  /**
+   * @param initial 初始计时点，聚合模式下本线程第一个计时点的耗时由此算起
+   */
+  Arena(std::thread::id owner,
+        std::uint32_t index,
+        Mode mode,
+        Clock::time_point initial) noexcept
+    : mOwner(owner)
+    , mIndex(index)
+    , mMode(mode)
+    , mLastTime(initial)
+  {
+  }
+
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+
+  ~Arena() noexcept
+  {
+    auto size = mSize.load(std::memory_order_relaxed);
+    for (auto* chunk = mFirst; chunk != nullptr;) {
+      auto n = std::min(size, kChunkEntries);
+      for (std::size_t i = 0; i < n; ++i)
+        chunk->at(i).~Entry();
+      size -= n;
+
+      auto* next = chunk->mNext.load(std::memory_order_relaxed);
+      delete chunk;
+      chunk = next;
+    }
+
+    if (mHasScratch)
+      scratch().~Entry();
+  }
+
+public:
+  /**
+   * @brief 追加一条记录，只能由所属线程调用。
+   */
+  Entry& emplace(Clock::time_point time,
+                 const char* tag,
+                 Info* info,
+                 bool owned,
+                 const Inline& inl,
+                 const PerfCounters::Sample* counters) noexcept
+  {
+    if (mMode == Mode::kAggregate)
+      return aggregate(time, tag, info, owned, inl);
+
+    // 读数在条目发布前写入，随条目一起对读者可见
+    if (counters)
+      counters = &mSamples.emplace_back(*counters);
+
+    auto size = mSize.load(std::memory_order_relaxed);
+    auto index = size % kChunkEntries;
+    if (index == 0) {
+      auto* chunk = new Chunk;
+      if (mLast)
+        mLast->mNext.store(chunk, std::memory_order_relaxed);
+      else
+        mFirst = chunk;
+      mLast = chunk;
+    }
+
+    auto* entry = new (mLast->mData[index])
+      Entry(time, tag, info, owned, inl, mIndex, depth(info), counters);
+    mSize.store(size + 1, std::memory_order_release);
+    return *entry;
+  }
+
+  /**
+   * @brief 将此刻已发布的条目追加到 out，可由任意线程调用。
+   */
+  void collect(std::vector<Entry*>& out) const
+  {
+    auto size = mSize.load(std::memory_order_acquire);
+    for (auto* chunk = mFirst; size != 0;) {
+      auto n = std::min(size, kChunkEntries);
+      for (std::size_t i = 0; i < n; ++i)
+        out.push_back(&chunk->at(i));
+      size -= n;
+      chunk = chunk->mNext.load(std::memory_order_relaxed);
+    }
+  }
+
+  /**
+   * @brief 将各标签的直方图按标签字符串累加到 out，可由任意线程调用。
+   */
+  void collect(std::map<std::string, Histogram>& out) const
+  {
+    std::lock_guard<std::mutex> lock(mHistMutex);
+    for (auto&& [tag, hist] : mHists)
+      out[tag].merge(*hist);
+  }
+
+private:
+  struct Chunk
+  {
+    alignas(Entry) unsigned char mData[kChunkEntries][sizeof(Entry)];
+    std::atomic<Chunk*> mNext{ nullptr };
+
+    Entry& at(std::size_t i) noexcept
+    {
+      return *std::launder(reinterpret_cast<Entry*>(mData[i]));
+    }
+  };
+
+private:
+  const Mode mMode;
+  std::uint32_t mDepth{ 0 };                 ///< 未离开的 Scope 层数
+  std::atomic<std::size_t> mSize{ 0 };       ///< 已发布的条目数
+  Chunk* mFirst{ nullptr };                  ///< 第一块，首次追加后不变
+  Chunk* mLast{ nullptr };                   ///< 最后一块，只由所属线程访问
+  std::deque<PerfCounters::Sample> mSamples; ///< 条目引用的计数器增量
+
+  ///@name 聚合模式，除 mHists 的插入外只由所属线程访问
+  ///@{
+  Clock::time_point mLastTime;            ///< 上一个计时点
+  std::vector<Clock::time_point> mEnters; ///< 未离开的 Scope 的进入时刻
+  std::unordered_map<const char*, std::unique_ptr<Histogram>> mHists;
+  mutable std::mutex mHistMutex; ///< 保护 mHists 的插入与其他线程的读取
+  alignas(Entry) unsigned char mScratch[sizeof(Entry)];
+  bool mHasScratch{ false };
+  ///@}
+
+private:
+  Entry& scratch() noexcept
+  {
+    return *std::launder(reinterpret_cast<Entry*>(mScratch));
+  }
+
+  /**
+   * @brief 新条目的嵌套深度，同时按 Scope 的进入和离开更新 mDepth。
+   */
+  std::uint32_t depth(const Info* info) noexcept
+  {
+    if (info == &Scope::gEnterInfo)
+      return mDepth++;
+    if (info == &Scope::gLeaveInfo && mDepth != 0)
+      return --mDepth;
+    return mDepth;
+  }
+
+  Histogram& histogram(const char* tag) noexcept
+  {
+    auto it = mHists.find(tag);
+    if (it == mHists.end()) {
+      std::lock_guard<std::mutex> lock(mHistMutex);
+      it = mHists.emplace(tag, std::make_unique<Histogram>()).first;
+    }
+    return *it->second;
+  }
+
+  Entry& aggregate(Clock::time_point time,
+                   const char* tag,
+                   Info* info,
+                   bool owned,
+                   const Inline& inl) noexcept
+  {
+    auto elapsed = [](Clock::time_point from, Clock::time_point to) {
+      auto ns = sc::duration_cast<sc::nanoseconds>(to - from).count();
+      return std::uint64_t(std::max<std::int64_t>(ns, 0));
+    };
+
+    if (info == &Scope::gEnterInfo)
+      mEnters.push_back(time);
+    else if (info == &Scope::gLeaveInfo && !mEnters.empty()) {
+      histogram(tag).record(elapsed(mEnters.back(), time));
+      mEnters.pop_back();
+    } else
+      histogram(tag).record(elapsed(mLastTime, time));
+    mLastTime = time;
+
+    if (mHasScratch)
+      scratch().~Entry();
+    mHasScratch = true;
+    return *new (mScratch)
+      Entry(time, tag, info, owned, inl, mIndex, depth(info), nullptr);
+  }
+};
+
+/**
+ * @brief 由浅拷贝的 Profiler 共享的计时序列。
+ */
+class Profiler::Sequence
+{
+public:
+  const std::uint64_t mId;              ///< 全局唯一的编号，用于线程缓存
+  const Clock::time_point mInitial;     ///< 初始计时点
+  const Mode mMode;                     ///< 记录方式
+  std::atomic<bool> mCounting{ false }; ///< 是否采样硬件计数器
+
+public:
+  explicit Sequence(Mode mode) noexcept
+    : mId(gNextId.fetch_add(1, std::memory_order_relaxed))
+    , mInitial(Clock::now())
+    , mMode(mode)
+  {
+  }
+
+public:
+  /**
+   * @brief 当前线程的条目区，不存在时创建。
+   *
+   * 线程缓存最近使用的序列，命中时无需加锁。
+   */
+  Arena& arena() noexcept
+  {
+    static thread_local std::uint64_t stId = 0;
+    static thread_local Arena* stArena = nullptr;
+    if (stId == mId)
+      return *stArena;
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto owner = std::this_thread::get_id();
+    auto it = std::find_if(mArenas.begin(), mArenas.end(), [&](auto& arena) {
+      return arena->mOwner == owner;
+    });
+    if (it == mArenas.end()) {
+      auto index = std::uint32_t(mArenas.size());
+      it = mArenas.insert(
+        it, std::make_unique<Arena>(owner, index, mMode, mInitial));
+    }
+
+    stId = mId, stArena = it->get();
+    return *stArena;
+  }
+
+  /**
+   * @brief 将各线程此刻已有的记录按计时点归并。
+   */
+  std::vector<Entry*> merge()
+  {
+    std::vector<Entry*> entries;
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      for (auto& arena : mArenas)
+        arena->collect(entries);
+    }
+    std::stable_sort(
+      entries.begin(), entries.end(), [](Entry* a, Entry* b) {
+        return a->mTime < b->mTime;
+      });
+    return entries;
+  }
+
+  /**
+   * @brief 合并各线程的直方图。
+   */
+  std::map<std::string, Histogram> histograms()
+  {
+    std::map<std::string, Histogram> ret;
+    std::lock_guard<std::mutex> lock(mMutex);
+    for (auto& arena : mArenas)
+      arena->collect(ret);
+    return ret;
+  }
+
+private:
+  static std::atomic<std::uint64_t> gNextId; ///< 从 1 开始，0 表示无效
+
+private:
+  std::mutex mMutex; ///< 保护 mArenas
+  std::vector<std::unique_ptr<Arena>> mArenas;
+};
+
+std::atomic<std::uint64_t> Profiler::Sequence::gNextId{ 1 };
+
+Profiler::Profiler()
+  : Profiler(Mode::kTrace)
+{
+}
+
+Profiler::Profiler(Mode mode)
+  : mSeq(std::make_shared<Sequence>(mode))
+{
+}
+
+Profiler::Clock::time_point
+Profiler::initial() const noexcept
+{
+  return mSeq->mInitial;
+}
+
+Profiler::Mode
+Profiler::mode() const noexcept
+{
+  return mSeq->mMode;
+}
+
+bool
+Profiler::enable_counters(bool enable) noexcept
+{
+  enable = enable && PerfCounters::local().available();
+  mSeq->mCounting.store(enable, std::memory_order_relaxed);
+  return enable;
+}
+
+bool
+Profiler::counting() const noexcept
+{
+  return mSeq->mCounting.load(std::memory_order_relaxed);
+}
+
+std::map<std::string, Profiler::Histogram>
+Profiler::histograms() const noexcept(false)
+{
+  return mSeq->histograms();
+}
+
+Profiler::Iterator
+Profiler::begin() const noexcept(false)
+{
+  return Iterator(std::make_shared<std::vector<Entry*>>(mSeq->merge()));
+}
+
 Profiler
 Profiler::from_json(const bj::value& json,
                     std::set<std::string>& tags) noexcept(false)
@@ -55,7 +438,7 @@ Profiler::from_json(const bj::value& json,
     const auto* tag =
       tags.emplace(ent.at(0).as_string().c_str()).first->c_str();
 
-    auto time = prof.mHead->mTime +
+    auto time = prof.initial() +
                 sc::duration_cast<Clock::duration>(
                   sc::duration<double, std::nano>(ent.at(1).as_double()));
 
@@ -65,13 +448,12 @@ Profiler::from_json(const bj::value& json,
     else
       info = new StrInfo(ent.at(2).as_string().c_str());
 
-    prof.mHead->mNext.store(
-      new Entry(time,
-                tag,
-                info,
-                bool(info),
-                prof.mHead->mNext.load(std::memory_order_relaxed)),
-      std::memory_order_relaxed);
+    PerfCounters::Sample counters;
+    if (ent.size() > 3)
+      counters = counters_from_json(ent.at(3).as_object());
+
+    prof.record(
+      time, tag, info, bool(info), {}, counters ? &counters : nullptr);
   }
 
   return prof;
@@ -82,35 +464,220 @@ Profiler::time(const char* tag, Info* info, bool owned) noexcept
 {
   assert(info || !owned); // info为空时，owned必须为false
 
-  auto* entry = new Entry(Clock::now(), tag, info, owned, nullptr);
-  auto* next = mHead->mNext.load(std::memory_order_relaxed);
-  do {
-    entry->mNext.store(next, std::memory_order_relaxed);
-  } while (!mHead->mNext.compare_exchange_weak(
-    next, entry, std::memory_order_relaxed));
+  auto& entry = record(Clock::now(), tag, info, owned, {});
+  report(entry);
+  return entry;
+}
 
-  report(*entry);
-  return *entry;
+Profiler::Entry&
+Profiler::time(const char* tag, const Inline& info) noexcept
+{
+  auto& entry = record(Clock::now(), tag, nullptr, false, info);
+  report(entry);
+  return entry;
+}
+
+Profiler::Entry&
+Profiler::leave(const char* tag, const PerfCounters::Sample& counters) noexcept
+{
+  auto& entry =
+    record(Clock::now(), tag, &Scope::gLeaveInfo, false, {}, &counters);
+  report(entry);
+  return entry;
+}
+
+Profiler::Entry&
+Profiler::record(Clock::time_point time,
+                 const char* tag,
+                 Info* info,
+                 bool owned,
+                 const Inline& inl,
+                 const PerfCounters::Sample* counters) noexcept
+{
+  return mSeq->arena().emplace(time, tag, info, owned, inl, counters);
 }
 
 bj::value
 Profiler::to_json() const noexcept(false)
 {
+  if (mode() == Mode::kAggregate) {
+    bj::object obj;
+    for (auto&& [tag, hist] : histograms())
+      obj[tag] = hist.to_json();
+    return obj;
+  }
+
   bj::array arr;
 
   for (auto&& i : *this) {
     bj::array ent;
     ent.emplace_back(i.mTag);
-    sc::duration<double, std::nano> dura(i.mTime - mHead->mTime);
+    sc::duration<double, std::nano> dura(i.mTime - initial());
     ent.emplace_back(dura.count());
-    if (i.mInfo)
-      ent.emplace_back(i.mInfo->info());
+    if (i.has_info())
+      ent.emplace_back(i.info());
+    if (i.mCounters)
+      ent.emplace_back(counters_to_json(*i.mCounters));
     arr.emplace_back(std::move(ent));
   }
 
   return arr;
 }
 
+bj::value
+Profiler::to_trace() const noexcept(false)
+{
+  bj::array events;
+  std::set<std::uint32_t> threads;
+
+  for (auto&& i : *this) {
+    auto event = [&](const char* phase) -> bj::object& {
+      bj::object obj;
+      obj["name"] = i.mTag;
+      obj["ph"] = phase;
+      obj["ts"] = sc::duration<double, std::micro>(i.mTime - initial()).count();
+      obj["pid"] = 0;
+      obj["tid"] = i.mThread;
+      return events.emplace_back(std::move(obj)).as_object();
+    };
+
+    threads.insert(i.mThread);
+    if (i.mInfo == &Scope::gEnterInfo)
+      event("B");
+    else if (i.mInfo == &Scope::gLeaveInfo) {
+      auto& obj = event("E");
+      if (i.mCounters)
+        obj["args"] = counters_to_json(*i.mCounters);
+    }
+    else {
+      auto& obj = event("i");
+      obj["s"] = "t";
+      if (i.has_info())
+        obj["args"].emplace_object()["info"] = i.info();
+      if (!i.mInfo && i.mInline.size() != 0) {
+        auto value = i.mInline.value(i.mInline.size() - 1);
+        event("C")["args"].emplace_object()["value"] = value;
+      }
+    }
+  }
+
+  for (auto i : threads) {
+    bj::object obj;
+    obj["name"] = "thread_name";
+    obj["ph"] = "M";
+    obj["pid"] = 0;
+    obj["tid"] = i;
+    obj["args"].emplace_object()["name"] = "thread " + std::to_string(i);
+    events.emplace_back(std::move(obj));
+  }
+
+  bj::object ret;
+  ret["traceEvents"] = std::move(events);
+  ret["displayTimeUnit"] = "ms";
+  return ret;
+}
+
+int
+Profiler::Histogram::bucket(std::uint64_t ns) noexcept
+{
+  if (ns < kSubs)
+    return ns;
+
+#if defined(__GNUC__) || defined(__clang__)
+  int e = 63 - __builtin_clzll(ns);
+#else
+  int e = kSubBits;
+  while (ns >> (e + 1))
+    ++e;
+#endif
+  int sub = (ns >> (e - kSubBits)) - kSubs;
+  return kSubs + (e - kSubBits) * kSubs + sub;
+}
+
+std::uint64_t
+Profiler::Histogram::lower(int bucket) noexcept
+{
+  if (bucket < kSubs)
+    return bucket;
+  int e = (bucket - kSubs) / kSubs + kSubBits;
+  std::uint64_t sub = (bucket - kSubs) % kSubs;
+  return (kSubs + sub) << (e - kSubBits);
+}
+
+void
+Profiler::Histogram::record(std::uint64_t ns) noexcept
+{
+  add(mCount, 1);
+  add(mSum, ns);
+  if (ns < load(mMin))
+    mMin.store(ns, std::memory_order_relaxed);
+  if (ns > load(mMax))
+    mMax.store(ns, std::memory_order_relaxed);
+  add(mBuckets[bucket(ns)], 1);
+}
+
+void
+Profiler::Histogram::merge(const Histogram& other) noexcept
+{
+  add(mCount, other.count());
+  add(mSum, other.sum());
+  mMin.store(std::min(load(mMin), load(other.mMin)), std::memory_order_relaxed);
+  mMax.store(std::max(max(), other.max()), std::memory_order_relaxed);
+  for (int i = 0; i < kBuckets; ++i)
+    add(mBuckets[i], load(other.mBuckets[i]));
+}
+
+std::uint64_t
+Profiler::Histogram::percentile(double q) const noexcept
+{
+  auto n = count();
+  if (n == 0)
+    return 0;
+
+  auto rank = std::max<std::uint64_t>(1, std::ceil(q * n));
+  std::uint64_t seen = 0;
+  for (int i = 0; i < kBuckets; ++i) {
+    if ((seen += load(mBuckets[i])) < rank)
+      continue;
+    auto upper = i + 1 < kBuckets ? lower(i + 1) - 1 : UINT64_MAX;
+    auto mid = lower(i) + (upper - lower(i)) / 2;
+    return std::clamp(mid, min(), max());
+  }
+  return max();
+}
+
+bj::value
+Profiler::Histogram::to_json() const noexcept(false)
+{
+  bj::object obj;
+  obj["count"] = count();
+  obj["total"] = sum();
+  obj["min"] = min();
+  obj["max"] = max();
+  obj["p50"] = percentile(0.5);
+  obj["p90"] = percentile(0.9);
+  obj["p99"] = percentile(0.99);
+  return obj;
+}
+
+std::string
+Profiler::Inline::str() const noexcept(false)
+{
+  std::string ret;
+  int i = 0;
+  for (auto* p = mFormat; *p != '\0'; ++p) {
+    if (p[0] == '{' && p[1] == '}' && i < mCount) {
+      if (mDoubles >> i & 1)
+        ret += std::to_string(mSlots[i].mDouble);
+      else
+        ret += std::to_string(mSlots[i].mInt);
+      ++i, ++p;
+    } else
+      ret += *p;
+  }
+  return ret;
+}
+
 Profiler::Scope::EnterInfo Profiler::Scope::gEnterInfo;
 Profiler::Scope::LeaveInfo Profiler::Scope::gLeaveInfo;
 
@@ -118,17 +685,6 @@ Profiler::Entry::~Entry() noexcept
 {
   if (mOwned)
     delete mInfo;
-
-  // 无需原子操作，因为析构操作只发生在最后持有 shared_ptr 的单个线程中。
-  auto* next = mNext.load(std::memory_order_relaxed);
-  if (next) {
-    while (next != nullptr) {
-      auto* nextnext = next->mNext.load(std::memory_order_relaxed);
-      next->mNext.store(nullptr, std::memory_order_relaxed);
-      delete next; // 先将 next 置空，防止陷入递归析构。
-      next = nextnext;
-    }
-  }
 }
 
 std::string
@@ -1,11 +1,17 @@
 #pragma once
 
+#include "PerfCounters.hpp"
 #include "cpp"
 #include <atomic>
 #include <chrono>
+#include <cstdint>
+#include <map>
 #include <memory>
 #include <ostream>
 #include <set>
+#include <string>
+#include <type_traits>
+#include <vector>
 
 namespace boost::json {
 class value;
@@ -27,12 +33,32 @@ namespace bj = boost::json;
 
 /**
  * @brief 线程安全的性能分析器。
+ *
+ * 每个线程把计时记录追加到自己的条目区中，条目区按块分配、块内顺序追加，
+ * 记录时既不分配内存（块满时除外），也不与其他线程共享缓存行。迭代和导出时
+ * 才将各线程的记录按时间归并。
+ *
+ * 聚合模式下不保留记录，每个线程按标签把耗时计入各自的直方图：Scope 的耗时
+ * 为进入到离开的时长，其他计时点的耗时为与本线程上一个计时点的间隔。内存
+ * 占用只与标签数和线程数有关。
+ *
+ * 开启硬件计数器后，Scope 在进入和离开时各读取一次当前线程的 PerfCounters，
+ * 差值记在离开的条目上；计数器不可用的线程只计时。
  */
 class Profiler
 {
 public:
   using Clock = std::chrono::high_resolution_clock;
 
+  /**
+   * @brief 记录方式。
+   */
+  enum class Mode
+  {
+    kTrace,     ///< 保留每条记录
+    kAggregate, ///< 只保留各标签的耗时直方图
+  };
+
   /**
    * @brief 用于给记录提供额外信息的接口类。
    */
@@ -59,11 +85,161 @@ public:
     std::string info() noexcept override { return *this; }
   };
 
+  /**
+   * @brief 内联在记录条目中的附加信息，由静态的格式串和至多 kSlots 个数值
+   * 组成，记录时不分配内存，导出时才格式化。
+   *
+   * 格式串中的 "{}" 依次替换为各个数值，格式同 std::to_string；没有数值时
+   * 就是一个静态字符串。
+   */
+  class Inline
+  {
+  public:
+    static constexpr int kSlots = 3; ///< 数值个数的上限
+
+  public:
+    Inline() noexcept = default;
+
+    /**
+     * @param format 格式串，须在 Profiler 的生命周期内有效
+     * @param args 整数或浮点数
+     */
+    template<typename... Args>
+    Inline(const char* format, Args... args) noexcept
+      : mFormat(format)
+    {
+      static_assert(sizeof...(Args) <= kSlots, "too many inline values");
+      (push(args), ...);
+    }
+
+  public:
+    explicit operator bool() const noexcept { return mFormat != nullptr; }
+
+    /**
+     * @brief 数值的个数。
+     */
+    int size() const noexcept { return mCount; }
+
+    /**
+     * @brief 第 i 个数值，整数转换为浮点数。
+     */
+    double value(int i) const noexcept
+    {
+      return mDoubles >> i & 1 ? mSlots[i].mDouble : mSlots[i].mInt;
+    }
+
+    /**
+     * @brief 格式化为字符串。
+     */
+    std::string str() const noexcept(false);
+
+  private:
+    union Slot
+    {
+      std::int64_t mInt;
+      double mDouble;
+    };
+
+  private:
+    const char* mFormat{ nullptr };
+    Slot mSlots[kSlots];
+    std::uint8_t mCount{ 0 };   ///< 数值个数
+    std::uint8_t mDoubles{ 0 }; ///< 第 i 位表示第 i 个数值是否为浮点数
+
+  private:
+    template<typename T>
+    void push(T t) noexcept
+    {
+      static_assert(std::is_arithmetic_v<T>, "inline values must be numbers");
+      if constexpr (std::is_floating_point_v<T>) {
+        mSlots[mCount].mDouble = t;
+        mDoubles |= 1 << mCount;
+      } else
+        mSlots[mCount].mInt = t;
+      ++mCount;
+    }
+  };
+
+  /**
+   * @brief 按对数线性分桶的耗时直方图，相对误差约为 1/kSubs。
+   *
+   * 小于 kSubs 纳秒的耗时各占一桶，更大的耗时按二进制的最高位分段，每段再
+   * 均分为 kSubs 桶。只能由一个线程记录，但可以由其他线程同时读取。
+   */
+  class Histogram
+  {
+  public:
+    static constexpr int kSubBits = 4;
+    static constexpr int kSubs = 1 << kSubBits;
+    static constexpr int kBuckets = kSubs + (64 - kSubBits) * kSubs;
+
+  public:
+    Histogram() noexcept = default;
+    Histogram(const Histogram&) = delete;
+    Histogram& operator=(const Histogram&) = delete;
+
+  public:
+    /**
+     * @brief 记录一次耗时，只能由一个线程调用。
+     */
+    void record(std::uint64_t ns) noexcept;
+
+    /**
+     * @brief 累加另一个直方图。
+     */
+    void merge(const Histogram& other) noexcept;
+
+    std::uint64_t count() const noexcept { return load(mCount); }
+    std::uint64_t sum() const noexcept { return load(mSum); }
+    std::uint64_t min() const noexcept { return count() ? load(mMin) : 0; }
+    std::uint64_t max() const noexcept { return load(mMax); }
+
+    /**
+     * @brief 分位数 q ∈ [0, 1] 处的耗时，取所在桶的中点并限制在最小值和
+     * 最大值之间，没有记录时为 0。
+     */
+    std::uint64_t percentile(double q) const noexcept;
+
+    /**
+     * @brief 导出次数、总耗时、最小值、最大值和 p50/p90/p99，耗时以纳秒计。
+     */
+    bj::value to_json() const noexcept(false);
+
+  private:
+    std::atomic<std::uint64_t> mCount{ 0 };
+    std::atomic<std::uint64_t> mSum{ 0 };
+    std::atomic<std::uint64_t> mMin{ UINT64_MAX };
+    std::atomic<std::uint64_t> mMax{ 0 };
+    std::atomic<std::uint64_t> mBuckets[kBuckets]{};
+
+  private:
+    static int bucket(std::uint64_t ns) noexcept;
+
+    static std::uint64_t lower(int bucket) noexcept;
+
+    static std::uint64_t load(const std::atomic<std::uint64_t>& a) noexcept
+    {
+      return a.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief 单个写者的原子更新，无需读改写指令。
+     */
+    static void add(std::atomic<std::uint64_t>& a, std::uint64_t v) noexcept
+    {
+      a.store(load(a) + v, std::memory_order_relaxed);
+    }
+  };
+
   class Entry;
   class Iterator;
   class Scope;
   class Profiled;
 
+private:
+  class Arena;
+  class Sequence;
+
 public:
   /**
    * @brief 从 JSON 导入。
@@ -85,6 +261,11 @@ public:
    */
   Profiler();
 
+  /**
+   * @brief 以指定的记录方式构造，浅拷贝的对象共享记录方式。
+   */
+  explicit Profiler(Mode mode);
+
   /**
    * @brief 该构造函数是浅拷贝，拷贝后的对象与原对象共享计时序列。
    */
@@ -101,6 +282,23 @@ public:
    */
   Clock::time_point initial() const noexcept;
 
+  /**
+   * @brief 获取记录方式。
+   */
+  Mode mode() const noexcept;
+
+  /**
+   * @brief 开启或关闭 Scope 的硬件计数器采样，浅拷贝的对象共享该设置。
+   *
+   * @return 是否开启，当前线程的计数器不可用时不开启。
+   */
+  bool enable_counters(bool enable = true) noexcept;
+
+  /**
+   * @brief 是否开启了硬件计数器采样。
+   */
+  bool counting() const noexcept;
+
   /**
    * @brief 记录一次计时。
    *
@@ -111,12 +309,19 @@ public:
    * @param info 附加信息，可为空。
    * @param owned 是否托管 info，若 info 为空则此参数必须为 false。
    *
-   * @return 本次计时构造的记录条目，是引用，当心指针悬挂。
+   * @return 本次计时构造的记录条目，是引用，当心指针悬挂。聚合模式下条目
+   * 不被保留，引用只在本线程下一次计时前有效。
    */
   Entry& time(const char* tag,
               Info* info = nullptr,
               bool owned = false) noexcept;
 
+  /**
+   * @brief 记录一次计时，附加信息内联在记录条目中，如
+   * time("KMeans-iter", Inline("MSE[{}]={}", step, mse))。
+   */
+  Entry& time(const char* tag, const Inline& info) noexcept;
+
   /**
    * @brief 在子类中重载这个方法以监视计时。
    *
@@ -126,18 +331,53 @@ public:
 
   /**
    * @brief 导出到 JSON。
+   *
+   * 带有硬件计数器增量的条目在附加信息之后多一个以事件名为键的对象。聚合
+   * 模式下导出以标签为键、Histogram::to_json() 为值的对象。
    */
   bj::value to_json() const noexcept(false);
 
+  /**
+   * @brief 导出为 Trace Event Format，可由 chrome://tracing 或 Perfetto
+   * 打开。
+   *
+   * 每个线程一条轨道，Scope 的进入和离开导出为 B/E 事件，其他计时点导出为
+   * 瞬时事件，附加信息在 args.info 中，硬件计数器增量在 E 事件的 args
+   * 中。内联附加信息的最后一个数值（如 KMeans 迭代的 MSE）同时导出为以标签
+   * 命名的计数器事件。时间以微秒计，从初始计时点算起。聚合模式下没有事件。
+   */
+  bj::value to_trace() const noexcept(false);
+
+  /**
+   * @brief 聚合模式下各标签的直方图，合并了各线程的记录。
+   */
+  std::map<std::string, Histogram> histograms() const noexcept(false);
+
 public:
-  ///@name 迭代器。
+  ///@name 迭代器，按计时点的先后顺序遍历此刻已有的记录。
   ///@{
-  Iterator begin() const noexcept;
+  Iterator begin() const noexcept(false);
   Iterator end() const noexcept;
   ///@}
 
 private:
-  std::shared_ptr<Entry> mHead;
+  std::shared_ptr<Sequence> mSeq;
+
+private:
+  /**
+   * @brief 在当前线程的条目区中追加一条记录。
+   */
+  Entry& record(Clock::time_point time,
+                const char* tag,
+                Info* info,
+                bool owned,
+                const Inline& inl,
+                const PerfCounters::Sample* counters = nullptr) noexcept;
+
+  /**
+   * @brief Scope 离开时的计时，附带硬件计数器的增量。
+   */
+  Entry& leave(const char* tag, const PerfCounters::Sample& counters) noexcept;
 
 private:
   friend std::ostream& ::operator<<(std::ostream& out, const Profiler& prof);
@@ -149,12 +389,19 @@ private:
 class Profiler::Entry
 {
   friend class Profiler;
+  friend class Arena;
 
 public:
   bool mOwned;             ///< 是否持有 mInfo
   Info* mInfo;             ///< 附加信息
+  Inline mInline;          ///< 内联的附加信息，mInfo 为空时使用
   const char* mTag;        ///< 计时标签
   Clock::time_point mTime; ///< 计时点
+  std::uint32_t mThread;   ///< 线程编号，按线程首次计时的顺序从 0 开始
+  std::uint32_t mDepth;    ///< 所在线程中未离开的 Scope 层数，不含自身
+
+  /// Scope 离开时的硬件计数器增量，未采样时为空
+  const PerfCounters::Sample* mCounters;
 
 public:
   Entry(const Entry&) = delete;
@@ -164,38 +411,61 @@ public:
 
   ~Entry() noexcept;
 
-private:
-  std::atomic<Entry*> mNext;
+public:
+  /**
+   * @brief 是否有附加信息。
+   */
+  bool has_info() const noexcept { return mInfo || mInline; }
 
-private:
-  Entry() = default;
+  /**
+   * @brief 获取附加信息，内联的附加信息在此时格式化。
+   */
+  std::string info() const noexcept(false)
+  {
+    return mInfo ? mInfo->info() : mInline.str();
+  }
 
+private:
   Entry(Clock::time_point time,
         const char* tag,
         Info* info,
         bool owned,
-        Entry* next)
+        const Inline& inl,
+        std::uint32_t thread,
+        std::uint32_t depth,
+        const PerfCounters::Sample* counters)
     : mOwned(owned)
     , mInfo(info)
+    , mInline(inl)
     , mTag(tag)
     , mTime(time)
-    , mNext(next)
+    , mThread(thread)
+    , mDepth(depth)
+    , mCounters(counters)
   {
   }
 };
 
+/**
+ * @brief 遍历归并后的记录快照，快照由 begin() 生成并为迭代器共享。
+ */
 class Profiler::Iterator
 {
 public:
-  Iterator(Entry* entry) noexcept
-    : mEntry(entry)
+  using Snapshot = std::shared_ptr<const std::vector<Entry*>>;
+
+public:
+  Iterator() noexcept = default;
+
+  Iterator(Snapshot entries) noexcept
+    : mEntries(std::move(entries))
   {
   }
 
 public:
   Iterator& operator++() noexcept
   {
-    mEntry = mEntry->mNext.load();
+    ++mIndex;
     return *this;
   }
 
@@ -208,24 +478,34 @@ public:
 
   bool operator==(const Iterator& other) const noexcept
   {
-    return mEntry == other.mEntry;
+    if (at_end() || other.at_end())
+      return at_end() == other.at_end();
+    return &**this == &*other;
   }
 
   bool operator!=(const Iterator& other) const noexcept
   {
-    return mEntry != other.mEntry;
+    return !(*this == other);
   }
 
-  Entry& operator*() const noexcept { return *mEntry; }
+  Entry& operator*() const noexcept { return *(*mEntries)[mIndex]; }
+
+  Entry* operator->() const noexcept { return (*mEntries)[mIndex]; }
 
-  Entry* operator->() const noexcept { return mEntry; }
+private:
+  Snapshot mEntries;
+  std::size_t mIndex{ 0 };
 
 private:
-  Entry* mEntry;
+  bool at_end() const noexcept
+  {
+    return !mEntries || mIndex == mEntries->size();
+  }
 };
 
 /**
- * @brief 作用域计时类，在构造时进行一次计时，在析构时再自动进行一次计时
+ * @brief 作用域计时类，在构造时进行一次计时，在析构时再自动进行一次计时，
+ * 开启了硬件计数器时还统计其间的计数器增量。
  */
 class Profiler::Scope
 {
@@ -250,6 +530,8 @@ public:
     , mTag(tag)
   {
     _.time(mTag, &gEnterInfo, false);
+    if (_.counting())
+      mCounters = PerfCounters::local().read();
   }
 
   Scope(const Scope&) = delete;
@@ -257,11 +539,18 @@ public:
   Scope& operator=(const Scope&) = delete;
   Scope& operator=(Scope&&) = delete;
 
-  ~Scope() { _.time(mTag, &gLeaveInfo, false); }
+  ~Scope()
+  {
+    if (mCounters)
+      _.leave(mTag, PerfCounters::local().read() - mCounters);
+    else
+      _.time(mTag, &gLeaveInfo, false);
+  }
 
 private:
   Profiler& _;
   const char* mTag;
+  PerfCounters::Sample mCounters; ///< 进入时的读数
 };
 
 namespace sc = std::chrono;
@@ -288,27 +577,10 @@ operator<<(std::ostream& out, const sc::duration<T1, T2>& dura)
 
 namespace Lib {
 
-inline Profiler::Profiler()
-  : mHead(new Entry(Clock::now(), nullptr, nullptr, false, nullptr))
-{
-}
-
-inline Profiler::Clock::time_point
-Profiler::initial() const noexcept
-{
-  return mHead->mTime;
-}
-
-inline Profiler::Iterator
-Profiler::begin() const noexcept
-{
-  return Iterator(mHead->mNext.load(std::memory_order_relaxed));
-}
-
 inline Profiler::Iterator
 Profiler::end() const noexcept
 {
-  return Iterator(nullptr);
+  return Iterator();
 }
 
 } // namespace Lib
@@ -0,0 +1,93 @@
+#include "Quantized.hpp"
+
+namespace Lib {
+
+template<>
+const MatxHeader::DType I8DataSet::kDType = MatxHeader::DType::kI8;
+
+template<>
+const MatxHeader::DType F16DataSet::kDType = MatxHeader::DType::kF16;
+
+template<>
+const MatxHeader::DType BF16DataSet::kDType = MatxHeader::DType::kBF16;
+
+template<typename Code>
+Quantized<Code>::Quantized(const DataView& data)
+{
+  Eigen::VectorXf lo = data.rowwise().minCoeff();
+  Eigen::VectorXf hi = data.rowwise().maxCoeff();
+
+  // 整数编码均匀划分取值范围，浮点编码则归一化到 [-1, 1]
+  float levels = std::is_integral_v<Code> ? 254 : 2;
+  mOffset = (lo + hi) / 2;
+  mScale = (hi - lo) / levels;
+  for (auto& s : mScale) {
+    if (!(s > 0)) // 该维为常数，任取非零的缩放系数
+      s = 1;
+  }
+
+  mCodes.resize(data.rows(), data.cols());
+#pragma omp parallel for
+  for (Eigen::Index i = 0; i < data.cols(); ++i) {
+    Eigen::VectorXf code = (data.col(i) - mOffset).cwiseQuotient(mScale);
+    if constexpr (std::is_integral_v<Code>)
+      code = code.array().round().max(-127).min(127);
+    mCodes.col(i) = code.template cast<Code>();
+  }
+}
+
+template<typename Code>
+void
+Quantized<Code>::decode(Eigen::Index begin, Eigen::Index n, DataSet* out) const
+{
+  out->resize(rows(), n);
+  for (Eigen::Index i = 0; i < n; ++i)
+    out->col(i) = col(begin + i);
+}
+
+template<typename Code>
+void
+Quantized<Code>::dump_bin(const char* path) const noexcept(false)
+{
+  CFile64 file(path, "wb");
+  CFile64::Closer closer(file);
+
+  MatxHeader header;
+  header.mDType = kDType;
+  header.mRows = rows();
+  header.mCols = cols();
+  file.write(&header, sizeof(header), 1);
+
+  file.seek(header.offset(), SEEK_SET);
+  file.write(mScale.data(), sizeof(float), rows());
+  file.write(mOffset.data(), sizeof(float), rows());
+  file.write(mCodes.data(), sizeof(Code), mCodes.size());
+}
+
+template<typename Code>
+void
+Quantized<Code>::load_bin(const char* path) noexcept(false)
+{
+  CFile64 file(path, "rb");
+  CFile64::Closer closer(file);
+
+  MatxHeader header;
+  header.read(file);
+  if (header.mDType != kDType)
+    throw err::Lit("mismatched matx dtype.");
+  if (!header.native())
+    throw err::Lit("non-native matx layout.");
+
+  mScale.resize(header.mRows);
+  mOffset.resize(header.mRows);
+  mCodes.resize(header.mRows, header.mCols);
+  file.read(mScale.data(), sizeof(float), rows());
+  file.read(mOffset.data(), sizeof(float), rows());
+  file.read(mCodes.data(), sizeof(Code), mCodes.size());
+}
+
+template class Quantized<std::int8_t>;
+template class Quantized<Eigen::half>;
+template class Quantized<Eigen::bfloat16>;
+
+} // namespace Lib
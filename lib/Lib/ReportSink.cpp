@@ -0,0 +1,115 @@
+#include "ReportSink.hpp"
+#include <chrono>
+
+namespace Lib {
+
+ReportSink::ReportSink(std::ostream& out,
+                       TagFilter filter,
+                       std::size_t capacity) noexcept(false)
+  : mOut(out)
+  , mFilter(std::move(filter))
+  , mMask([capacity]() {
+    std::size_t n = 1;
+    while (n < capacity)
+      n <<= 1;
+    return n - 1;
+  }())
+  , mCells(new Cell[mMask + 1])
+{
+  for (std::size_t i = 0; i <= mMask; ++i)
+    mCells[i].mSeq.store(i, std::memory_order_relaxed);
+  mThread = std::thread(&ReportSink::drain, this);
+}
+
+ReportSink::~ReportSink() noexcept
+{
+  mStop.store(true, std::memory_order_release);
+  mThread.join();
+}
+
+bool
+ReportSink::push(const Profiler::Entry& entry,
+                 Profiler::Clock::time_point initial) noexcept
+{
+  if (!mFilter.match(entry.mTag))
+    return false;
+
+  // 有界多生产者队列：单元的 mSeq 等于写入位置时可写，写完置为位置加一
+  auto pos = mTail.load(std::memory_order_relaxed);
+  Cell* cell;
+  for (;;) {
+    cell = &mCells[pos & mMask];
+    auto seq = cell->mSeq.load(std::memory_order_acquire);
+    auto diff = std::intptr_t(seq) - std::intptr_t(pos);
+    if (diff == 0) {
+      if (mTail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+        break;
+    } else if (diff < 0) {
+      mDropped.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    } else
+      pos = mTail.load(std::memory_order_relaxed);
+  }
+
+  auto& record = cell->mRecord;
+  record.mTime = entry.mTime - initial;
+  record.mTag = entry.mTag;
+  record.mInfo = nullptr;
+  record.mInline = {};
+  record.mText.clear();
+  if (entry.mInfo == &Profiler::Scope::gEnterInfo ||
+      entry.mInfo == &Profiler::Scope::gLeaveInfo)
+    record.mInfo = entry.mInfo;
+  else if (entry.mInfo)
+    record.mText = entry.mInfo->info();
+  else
+    record.mInline = entry.mInline;
+
+  cell->mSeq.store(pos + 1, std::memory_order_release);
+  return true;
+}
+
+bool
+ReportSink::pop(Record& record) noexcept
+{
+  auto& cell = mCells[mHead & mMask];
+  if (cell.mSeq.load(std::memory_order_acquire) != mHead + 1)
+    return false;
+
+  std::swap(record, cell.mRecord);
+  cell.mSeq.store(mHead + mMask + 1, std::memory_order_release);
+  ++mHead;
+  return true;
+}
+
+void
+ReportSink::drain() noexcept
+{
+  Record record;
+  for (;;) {
+    // 先读停止标志，保证停止前放入的记录都会被输出
+    bool stop = mStop.load(std::memory_order_acquire);
+
+    bool any = false;
+    while (pop(record)) {
+      mOut << record.mTime << " " << record.mTag;
+      if (record.mInfo)
+        mOut << " " << record.mInfo->info();
+      else if (!record.mText.empty())
+        mOut << " " << record.mText;
+      else if (record.mInline)
+        mOut << " " << record.mInline.str();
+      mOut << '\n';
+      any = true;
+    }
+
+    if (any)
+      mOut.flush();
+    else if (stop)
+      break;
+    else
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+}
+
+} // namespace Lib
@@ -0,0 +1,107 @@
+#pragma once
+
+#include "Profiler.hpp"
+#include "TagFilter.hpp"
+#include <atomic>
+#include <memory>
+#include <ostream>
+#include <thread>
+
+namespace Lib {
+
+/**
+ * @brief 异步输出计时记录的接收端，供 Profiler::report 的重载使用。
+ *
+ * 计算线程只按 TagFilter 过滤并把记录复制进无锁的有界环形缓冲区，格式化
+ * 与输出由后台线程完成。缓冲区满时新记录被丢弃而不阻塞计算线程。
+ *
+ * 内联的附加信息和 Scope 的进入、离开信息在后台线程格式化，其他 Info 在
+ * 计算线程上格式化，因为它们的生命周期可能短于记录被输出的时刻。
+ */
+class ReportSink
+{
+public:
+  /**
+   * @param out 输出流，在接收端的生命周期内只由后台线程写入
+   * @param filter 标签过滤器
+   * @param capacity 缓冲区的记录数，向上取整为 2 的幂
+   */
+  explicit ReportSink(std::ostream& out,
+                      TagFilter filter = {},
+                      std::size_t capacity = 4096) noexcept(false);
+
+  ReportSink(const ReportSink&) = delete;
+  ReportSink& operator=(const ReportSink&) = delete;
+
+  /**
+   * @brief 输出缓冲区中剩余的记录后停止后台线程。
+   */
+  ~ReportSink() noexcept;
+
+public:
+  /**
+   * @brief 放入一条记录，可由多个线程同时调用。
+   *
+   * 输出格式为 "时间 标签 [附加信息]"，时间从 initial 算起。
+   *
+   * @return 是否放入，被过滤或者缓冲区满时为 false。
+   */
+  bool push(const Profiler::Entry& entry,
+            Profiler::Clock::time_point initial) noexcept;
+
+  /**
+   * @brief 因缓冲区满而丢弃的记录数。
+   */
+  std::uint64_t dropped() const noexcept
+  {
+    return mDropped.load(std::memory_order_relaxed);
+  }
+
+private:
+  struct Record
+  {
+    Profiler::Clock::duration mTime;
+    const char* mTag;
+    Profiler::Info* mInfo; ///< 只会是 Scope 的进入或离开信息
+    Profiler::Inline mInline;
+    std::string mText; ///< 在计算线程上格式化的附加信息
+  };
+
+  /**
+   * @brief 环形缓冲区的单元，mSeq 标明单元可写入或可读出的轮次。
+   */
+  struct alignas(64) Cell
+  {
+    std::atomic<std::size_t> mSeq;
+    Record mRecord;
+  };
+
+private:
+  std::ostream& mOut;
+  const TagFilter mFilter;
+
+  const std::size_t mMask;        ///< 单元数减一
+  std::unique_ptr<Cell[]> mCells; ///< 环形缓冲区
+
+  /// 下一个写入位置
+  alignas(64) std::atomic<std::size_t> mTail{ 0 };
+  /// 下一个读出位置，只由后台线程访问
+  alignas(64) std::size_t mHead{ 0 };
+
+  std::atomic<std::uint64_t> mDropped{ 0 };
+  std::atomic<bool> mStop{ false };
+  std::thread mThread;
+
+private:
+  /**
+   * @brief 后台线程：取出并输出记录，空闲时短暂休眠。
+   */
+  void drain() noexcept;
+
+  /**
+   * @brief 取出一条记录，只由后台线程调用。
+   */
+  bool pop(Record& record) noexcept;
+};
+
+} // namespace Lib
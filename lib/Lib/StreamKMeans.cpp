@@ -0,0 +1,158 @@
+#include "StreamKMeans.hpp"
+#include "kernels.hpp"
+#include <algorithm>
+#include <future>
+#include <random>
+#include <string>
+
+namespace Lib {
+
+namespace {
+
+using Scalar = DataSet::value_type;
+
+}
+
+void
+StreamKMeans::operator()(const char* dataPath,
+                         int k,
+                         const char* cataPath,
+                         double* mse,
+                         DataSet* centers) noexcept(false)
+{
+  if (mEngine != KMeans::Engine::kLloyd && mEngine != KMeans::Engine::kGemm)
+    throw err::Lit("StreamKMeans only supports kLloyd and kGemm.");
+
+  auto rand = kernels::make_random(mSeed);
+
+  Scope scopeKMeans(*this, "StreamKMeans");
+
+  CFile64::Closers files;
+  CFile64 data(dataPath, "rb");
+  files.push_back(data);
+
+  MatxHeader header;
+  std::int64_t dataOffset = header.read(data);
+  if (!header.holds<Scalar>())
+    throw err::Lit("mismatched matx dtype.");
+  if (!header.native())
+    throw err::Lit("non-native matx layout.");
+  std::int64_t dims = header.mRows, dataNums = header.mCols;
+  if (dataNums < k)
+    throw err::Lit("fewer points than clusters.");
+
+  CFile64 cata;
+  MatxHeader cataHeader;
+  cataHeader.mDType = MatxHeader::dtype_of<Catalog::value_type>();
+  cataHeader.mRows = dataNums, cataHeader.mCols = 1;
+  if (cataPath) {
+    cata = CFile64(cataPath, "wb");
+    files.push_back(cata);
+    cata.write(&cataHeader, sizeof(cataHeader), 1);
+  }
+
+  // pread 不移动文件位置，后台线程读取时主线程也可以读取
+  auto read_cols = [&](std::int64_t begin, std::int64_t cols, Scalar* out) {
+    std::int64_t bytes = sizeof(Scalar) * dims * cols;
+    if (data.pread(out, bytes, dataOffset + sizeof(Scalar) * dims * begin) !=
+        bytes)
+      throw err::Lit("unexpected end of matx file.");
+  };
+
+  // 初始化：分层随机，将数据集均分为 k 段，每段随机选一个点
+  DataSet initial;
+  auto& ctrs = centers ? *centers : initial;
+  ctrs.resize(dims, k);
+  for (std::uint64_t i = 0; i < k; ++i) {
+    auto x = std::uniform_int_distribution<std::int64_t>(
+      i * dataNums / k, (i + 1) * dataNums / k - 1)(rand);
+    read_cols(x, 1, ctrs.col(i).data());
+  }
+  time("StreamKMeans-init");
+
+  std::int64_t chunkCols = std::max(mChunkCols, 1);
+  std::int64_t chunkNums = (dataNums + chunkCols - 1) / chunkCols;
+  auto load = [&](std::int64_t c, DataSet* buf) {
+    std::int64_t begin = c * chunkCols;
+    buf->resize(dims, std::min(chunkCols, dataNums - begin));
+    read_cols(begin, buf->cols(), buf->data());
+    data.readahead(dataOffset + sizeof(Scalar) * dims * (begin + chunkCols),
+                   sizeof(Scalar) * dims * chunkCols);
+  };
+
+  // 双缓冲：后台线程读取下一块时，当前线程处理另一块
+  DataSet chunks[2];
+  auto stream = [&](auto&& fn) {
+    auto next = std::async(std::launch::async, load, 0, &chunks[0]);
+    for (std::int64_t c = 0; c < chunkNums; ++c) {
+      next.get();
+      auto& chunk = chunks[c % 2];
+      if (c + 1 < chunkNums)
+        next =
+          std::async(std::launch::async, load, c + 1, &chunks[(c + 1) % 2]);
+      fn(c, chunk);
+    }
+  };
+
+  // 分类，对块中每个点，找到最近的k_idx，返回块的均方误差
+  Catalog labels;
+  auto assign = [&](const DataSet& chunk) {
+    labels.resize(chunk.cols());
+    if (mEngine == KMeans::Engine::kGemm)
+      return kernels::assign_gemm(chunk, ctrs, labels);
+    return kernels::assign_lloyd(chunk, ctrs, labels);
+  };
+
+  kernels::Accumulator accum;
+  Eigen::MatrixXd sums(dims, k);
+  Eigen::Matrix<std::int64_t, Eigen::Dynamic, 1> kcount(k);
+
+  double mseLast = 0;
+  for (int step = 0;; step++) {
+    sums.setZero();
+    kcount.setZero();
+    double sse = 0;
+
+    stream([&](std::int64_t, const DataSet& chunk) {
+      sse += assign(chunk) * chunk.cols();
+      accum(chunk, labels, k);
+      sums += accum.sums();
+      kcount += accum.counts().cast<std::int64_t>();
+    });
+    *mse = sse / dataNums;
+
+    // 更新聚类中心
+    for (int i = 0; i < k; ++i) {
+      if (kcount(i) == 0) {
+        // 应对离群中心点，重新随机生成
+        read_cols(
+          std::uniform_int_distribution<std::int64_t>(0, dataNums - 1)(rand),
+          1,
+          ctrs.col(i).data());
+      } else {
+        ctrs.col(i) = (sums.col(i) / kcount(i)).cast<Scalar>();
+      }
+    }
+
+    // 收敛条件
+    if (std::abs((*mse - mseLast) / *mse) < mEpsRatio)
+      break;
+    mseLast = step == 0 ? *mse : (mseLast + *mse) / 2;
+
+    time("StreamKMeans-iter", Inline("MSE[{}]={}", step, *mse));
+  }
+
+  // 聚类结果只在收敛后写入一次，各点归属于最终的中心点
+  if (cata) {
+    stream([&](std::int64_t c, const DataSet& chunk) {
+      assign(chunk);
+      cata.write(labels.data(),
+                 sizeof(Catalog::value_type),
+                 labels.size(),
+                 cataHeader.offset() +
+                   sizeof(Catalog::value_type) * c * chunkCols);
+    });
+  }
+}
+
+} // namespace Lib
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "KMeans.hpp"
+#include "Profiler.hpp"
+#include "lib.hpp"
+
+namespace Lib {
+
+/**
+ * @brief 外存版 KMeans，数据集不必装入内存。
+ *
+ * 每轮迭代按固定大小的列块顺序读取 matx_dump_bin 格式的数据集文件，逐块完成
+ * 分配并累加各类的坐标和，读取下一块与计算当前块重叠进行；聚类结果逐块写入
+ * 同样格式的二进制文件。内存占用只与块大小、维数和聚类数有关。
+ *
+ * 数据集文件的元素须为 float。
+ */
+class StreamKMeans : public Profiler
+{
+public:
+  DataSet::value_type mEpsRatio{ 0.001 };          ///< 判断收敛的MSE变化率阈值
+  KMeans::Engine mEngine{ KMeans::Engine::kGemm }; ///< 只支持 kLloyd 和 kGemm
+  unsigned mSeed{ 0 };     ///< 随机数种子，为 0 时随机生成
+  int mChunkCols{ 65536 }; ///< 每块的点数
+
+public:
+  StreamKMeans() = default;
+
+  StreamKMeans(const Profiler& prof)
+    : Profiler(prof)
+  {
+  }
+
+public:
+  /**
+   * @param[in] dataPath 数据集文件路径
+   * @param[in] k 聚类数
+   * @param[in] cataPath 聚类结果文件路径，为空时不输出，收敛后另读一遍数据写入
+   * @param[out] mse 误差
+   * @param[out] centers 最终的中心点，可为空
+   */
+  void operator()(const char* dataPath,
+                  int k,
+                  const char* cataPath,
+                  double* mse,
+                  DataSet* centers = nullptr) noexcept(false);
+};
+
+} // namespace Lib
@@ -0,0 +1,97 @@
+#include "TagFilter.hpp"
+#include "err.hpp"
+#include <atomic>
+#include <cstring>
+#include <unordered_map>
+
+namespace Lib {
+
+namespace {
+
+std::atomic<std::uint64_t> gNextId{ 1 }; ///< 从 1 开始，0 表示无效
+
+/// 去掉结尾的 '*' 或 ".*" 后模式中不允许出现的正则表达式元字符
+constexpr const char* kMetaChars = ".*[](){}?+^$\\";
+
+bool
+ends_with(const std::string& str, const char* suffix)
+{
+  auto len = std::strlen(suffix);
+  return str.size() >= len && !str.compare(str.size() - len, len, suffix);
+}
+
+} // namespace
+
+TagFilter::TagFilter() noexcept
+  : mId(gNextId.fetch_add(1, std::memory_order_relaxed))
+{
+}
+
+TagFilter::TagFilter(const char* spec) noexcept(false)
+  : TagFilter()
+{
+  if (spec == nullptr)
+    return;
+
+  for (auto* p = spec;; ++p) {
+    auto* end = p + std::strcspn(p, ",|");
+    std::string pattern(p, end);
+    if (!pattern.empty() && pattern.back() == '\\')
+      pattern.pop_back();
+
+    bool prefix = false;
+    if (ends_with(pattern, ".*"))
+      pattern.resize(pattern.size() - 2), prefix = true;
+    else if (ends_with(pattern, "*"))
+      pattern.resize(pattern.size() - 1), prefix = true;
+
+    // 不支持的正则表达式不能悄悄地变成什么都不匹配的精确模式
+    if (pattern.find_first_of(kMetaChars) != std::string::npos)
+      throw err::Lit("unsupported regex in tag filter, "
+                     "only 'A|B' and trailing '*' or '.*' are allowed.");
+
+    if (prefix)
+      mPrefixes.push_back(std::move(pattern));
+    else if (!pattern.empty())
+      mExact.insert(std::move(pattern));
+
+    if (*(p = end) == '\0')
+      break;
+  }
+
+  mAll = mExact.empty() && mPrefixes.empty();
+}
+
+bool
+TagFilter::match(const char* tag) const noexcept
+{
+  if (mAll)
+    return true;
+
+  // 线程缓存最近使用的过滤器的判断结果
+  static thread_local std::uint64_t stId = 0;
+  static thread_local std::unordered_map<const char*, bool> stCache;
+  if (stId != mId) {
+    stCache.clear();
+    stId = mId;
+  }
+
+  auto it = stCache.find(tag);
+  if (it == stCache.end())
+    it = stCache.emplace(tag, lookup(tag)).first;
+  return it->second;
+}
+
+bool
+TagFilter::lookup(const char* tag) const noexcept
+{
+  if (mExact.count(tag))
+    return true;
+  for (auto&& i : mPrefixes) {
+    if (!std::strncmp(tag, i.c_str(), i.size()))
+      return true;
+  }
+  return false;
+}
+
+} // namespace Lib
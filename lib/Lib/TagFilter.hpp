@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace Lib {
+
+/**
+ * @brief 计时标签的过滤器，由精确匹配和前缀匹配的模式组成。
+ *
+ * 标签按指针区分，即视为已驻留的字符串：每个线程第一次遇到某个标签时按
+ * 模式判断一次，结果缓存在线程局部的表中，之后只需一次指针的哈希查找。
+ * 标签须在过滤器的生命周期内有效且内容不变。
+ */
+class TagFilter
+{
+public:
+  /**
+   * @brief 匹配一切标签。
+   */
+  TagFilter() noexcept;
+
+  /**
+   * @param spec 以 ',' 或 '|' 分隔的模式，以 '*' 或 ".*" 结尾的模式按
+   * 前缀匹配，其余按精确匹配；为空时匹配一切。分隔符前的 '\' 被忽略，
+   * 因此 "A\|B.*" 这样的简单正则表达式也能使用；模式中有其他正则表达式
+   * 元字符时（如 ".*iter"、"[AB]"）抛出异常。
+   */
+  explicit TagFilter(const char* spec) noexcept(false);
+
+public:
+  /**
+   * @brief 是否匹配一切标签。
+   */
+  bool all() const noexcept { return mAll; }
+
+  /**
+   * @brief 标签是否匹配，可由多个线程同时调用。
+   */
+  bool match(const char* tag) const noexcept;
+
+private:
+  std::uint64_t mId; ///< 全局唯一的编号，用于线程缓存
+  bool mAll{ true };
+  std::set<std::string> mExact;
+  std::vector<std::string> mPrefixes;
+
+private:
+  /**
+   * @brief 不经缓存地按模式判断。
+   */
+  bool lookup(const char* tag) const noexcept;
+};
+
+} // namespace Lib
@@ -0,0 +1,262 @@
+#include "WarmStart.hpp"
+#include "kernels.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace Lib {
+
+namespace {
+
+constexpr int kRecordChunks = 64;              ///< 统计各类信息时的分段数上限
+constexpr double kPi = 3.14159265358979323846; ///< M_PI 不是标准 C++
+
+}
+
+void
+WarmStart::operator()(KMeans& kmeans,
+                      const DataView& data,
+                      int k,
+                      Catalog* cata,
+                      double* mse)
+{
+  run(kmeans, data, k, cata, mse);
+}
+
+void
+WarmStart::operator()(KMeans& kmeans,
+                      const F64DataView& data,
+                      int k,
+                      Catalog* cata,
+                      double* mse)
+{
+  run(kmeans, data, k, cata, mse);
+}
+
+template<typename Code>
+void
+WarmStart::operator()(KMeans& kmeans,
+                      const Quantized<Code>& data,
+                      int k,
+                      Catalog* cata,
+                      double* mse)
+{
+  run(kmeans, data, k, cata, mse);
+}
+
+void
+WarmStart::record(const DataView& data,
+                  const DataSet& centers,
+                  const Catalog& cata)
+{
+  kernels::dispatch_dims(
+    data, [&](const auto& view) { tally(view, centers, cata); });
+}
+
+void
+WarmStart::record(const F64DataView& data,
+                  const F64DataSet& centers,
+                  const Catalog& cata)
+{
+  kernels::dispatch_dims(
+    data, [&](const auto& view) { tally(view, centers, cata); });
+}
+
+template<typename Code>
+void
+WarmStart::record(const Quantized<Code>& data,
+                  const DataSet& centers,
+                  const Catalog& cata)
+{
+  tally(data, centers, cata);
+}
+
+template<typename Data>
+void
+WarmStart::run(KMeans& kmeans,
+               const Data& data,
+               int k,
+               Catalog* cata,
+               double* mse)
+{
+  kernels::CentersOf<Data> centers;
+  if (seed(k, &centers))
+    kmeans(data, &centers, cata, mse);
+  else
+    kmeans(data, k, cata, mse, &centers);
+  record(data, centers, *cata);
+}
+
+template<typename Data>
+void
+WarmStart::tally(const Data& data,
+                 const kernels::CentersOf<Data>& centers,
+                 const Catalog& cata)
+{
+  int dims = data.rows();
+  int k = centers.cols();
+  int dataNums = data.cols();
+
+  // 分段统计后按顺序合并，使结果与线程数无关
+  int chunks = std::clamp(dataNums, 1, kRecordChunks);
+  std::vector<Eigen::VectorXd> counts(chunks);
+  std::vector<Eigen::MatrixXd> sqSums(chunks);
+#pragma omp parallel for schedule(static)
+  for (int c = 0; c < chunks; ++c) {
+    counts[c].setZero(k);
+    sqSums[c].setZero(dims, k);
+    int end = std::int64_t(dataNums) * (c + 1) / chunks;
+    for (int i = std::int64_t(dataNums) * c / chunks; i < end; ++i) {
+      int j = cata(i);
+      counts[c](j) += 1;
+      sqSums[c].col(j) +=
+        (data.col(i) - centers.col(j)).template cast<double>().cwiseAbs2();
+    }
+  }
+
+  Record rec;
+  rec.mCenters = centers.template cast<double>();
+  rec.mCounts = counts[0];
+  rec.mVariance = sqSums[0];
+  for (int c = 1; c < chunks; ++c) {
+    rec.mCounts += counts[c];
+    rec.mVariance += sqSums[c];
+  }
+  rec.mSse = rec.mVariance.colwise().sum().transpose();
+  for (int j = 0; j < k; ++j) {
+    if (rec.mCounts(j) > 0)
+      rec.mVariance.col(j) /= rec.mCounts(j);
+  }
+
+  std::lock_guard<std::mutex> lock(mMutex);
+  mRecords[k] = std::move(rec);
+}
+
+template<typename _Scalar>
+bool
+WarmStart::seed(int k, BasicDataSet<_Scalar>* centers) const
+{
+  Record rec;
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mRecords.empty())
+      return false;
+
+    // 优先从不小于 k 的最近记录合并得到，合并比分裂更不容易陷入局部最优
+    auto iter = mRecords.lower_bound(k);
+    if (iter == mRecords.end())
+      --iter;
+    rec = iter->second;
+  }
+
+  auto& ctrs = rec.mCenters;
+  auto& counts = rec.mCounts;
+  auto& sse = rec.mSse;
+  auto& variance = rec.mVariance;
+
+  // 分裂：每次将误差平方和最大的类沿方差最大的维度一分为二
+  while (ctrs.cols() < k) {
+    int n = ctrs.cols(), j, dim;
+    sse.maxCoeff(&j);
+    variance.col(j).maxCoeff(&dim);
+    auto offset = std::sqrt(variance(dim, j));
+
+    ctrs.conservativeResize(Eigen::NoChange, n + 1);
+    counts.conservativeResize(n + 1);
+    sse.conservativeResize(n + 1);
+    variance.conservativeResize(Eigen::NoChange, n + 1);
+
+    ctrs.col(n) = ctrs.col(j);
+    ctrs(dim, n) += offset;
+    ctrs(dim, j) -= offset;
+    counts(j) = counts(n) = counts(j) / 2;
+    sse(j) = sse(n) = sse(j) / 2;
+    variance(dim, j) *= 1 - 2 / kPi; // 半正态分布的方差
+    variance.col(n) = variance.col(j);
+  }
+
+  // 合并：每次将距离最近的两个中心点按点数加权平均。维护每个中心点的最近
+  // 邻，合并后只重新计算最近邻是被合并的两个点之一的中心点，每次合并的代价
+  // 从 O(n^2 d) 降为 O(n d)
+  std::vector<int> nn(ctrs.cols());
+  std::vector<double> nnDist(ctrs.cols());
+  auto dist = [&](int i, int j) {
+    return (ctrs.col(i) - ctrs.col(j)).squaredNorm();
+  };
+  auto nearest = [&](int i) {
+    nnDist[i] = std::numeric_limits<double>::max();
+    for (int j = 0; j < ctrs.cols(); ++j) {
+      if (j != i && dist(i, j) < nnDist[i])
+        nnDist[i] = dist(i, j), nn[i] = j;
+    }
+  };
+  if (ctrs.cols() > k) {
+    for (int i = 0; i < ctrs.cols(); ++i)
+      nearest(i);
+  }
+
+  while (ctrs.cols() > k) {
+    int n = ctrs.cols();
+    int a = std::min_element(nnDist.begin(), nnDist.end()) - nnDist.begin();
+    int b = nn[a];
+    if (a > b)
+      std::swap(a, b);
+
+    auto total = counts(a) + counts(b);
+    if (total > 0)
+      ctrs.col(a) =
+        (ctrs.col(a) * counts(a) + ctrs.col(b) * counts(b)) / total;
+    counts(a) = total;
+
+    // 将最后一列移到 b 处
+    ctrs.col(b) = ctrs.col(n - 1);
+    counts(b) = counts(n - 1);
+    nn[b] = nn[n - 1];
+    nnDist[b] = nnDist[n - 1];
+    ctrs.conservativeResize(Eigen::NoChange, n - 1);
+    counts.conservativeResize(n - 1);
+    nn.pop_back();
+    nnDist.pop_back();
+
+    for (int i = 0; i < n - 1; ++i) {
+      if (i == a)
+        continue;
+      if (nn[i] == a || nn[i] == b) {
+        nearest(i);
+        continue;
+      }
+      if (nn[i] == n - 1)
+        nn[i] = b;
+      if (dist(i, a) < nnDist[i])
+        nnDist[i] = dist(i, a), nn[i] = a;
+    }
+    nearest(a);
+  }
+
+  *centers = ctrs.cast<_Scalar>();
+  return true;
+}
+
+template bool WarmStart::seed(int, DataSet*) const;
+template bool WarmStart::seed(int, F64DataSet*) const;
+
+void
+WarmStart::clear()
+{
+  std::lock_guard<std::mutex> lock(mMutex);
+  mRecords.clear();
+}
+
+#define LIB_INSTANTIATE(Code)                                                  \
+  template void WarmStart::operator()(                                         \
+    KMeans&, const Quantized<Code>&, int, Catalog*, double*);                  \
+  template void WarmStart::record(                                             \
+    const Quantized<Code>&, const DataSet&, const Catalog&);
+
+LIB_INSTANTIATE(std::int8_t)
+LIB_INSTANTIATE(Eigen::half)
+LIB_INSTANTIATE(Eigen::bfloat16)
+
+#undef LIB_INSTANTIATE
+
+} // namespace Lib
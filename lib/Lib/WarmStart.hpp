@@ -0,0 +1,114 @@
+#pragma once
+
+#include "KMeans.hpp"
+#include "lib.hpp"
+#include <map>
+#include <mutex>
+
+namespace Lib {
+
+/**
+ * @brief 搜索聚类数时的热启动器，保存已求得的各聚类数的中心点，为新的聚类数
+ * 生成初始中心点。
+ *
+ * 新聚类数 k 以不小于 k 的最近已求聚类数 k' 的中心点为起点，反复合并距离最近
+ * 的两个中心点；若没有这样的 k'，则以最大的已求聚类数为起点，反复将误差平方和
+ * 最大的类沿方差最大的维度一分为二。
+ *
+ * 该类是线程安全的。
+ */
+class WarmStart
+{
+public:
+  /**
+   * @brief 运行一次 KMeans，有可用的记录时热启动，否则冷启动，并记录结果。
+   *
+   * @param[in] kmeans 使用的 KMeans 对象
+   * @param[in] data 数据集
+   * @param[in] k 聚类数
+   * @param[out] cata 聚类结果
+   * @param[out] mse 误差
+   */
+  void operator()(KMeans& kmeans,
+                  const DataView& data,
+                  int k,
+                  Catalog* cata,
+                  double* mse);
+
+  /**
+   * @brief double 精度版。
+   */
+  void operator()(KMeans& kmeans,
+                  const F64DataView& data,
+                  int k,
+                  Catalog* cata,
+                  double* mse);
+
+  /**
+   * @brief 量化数据集版。
+   */
+  template<typename Code>
+  void operator()(KMeans& kmeans,
+                  const Quantized<Code>& data,
+                  int k,
+                  Catalog* cata,
+                  double* mse);
+
+  /**
+   * @brief 记录一次聚类的最终中心点，并统计各类的点数、误差平方和与各维方差。
+   */
+  void record(const DataView& data,
+              const DataSet& centers,
+              const Catalog& cata);
+
+  /**
+   * @brief double 精度版。
+   */
+  void record(const F64DataView& data,
+              const F64DataSet& centers,
+              const Catalog& cata);
+
+  /**
+   * @brief 量化数据集版。
+   */
+  template<typename Code>
+  void record(const Quantized<Code>& data,
+              const DataSet& centers,
+              const Catalog& cata);
+
+  /**
+   * @brief 为聚类数 k 生成初始中心点，记录按 double 保存，可以生成任意精度的
+   * 中心点。
+   *
+   * @return 没有可用的记录时返回 false。
+   */
+  template<typename _Scalar>
+  bool seed(int k, BasicDataSet<_Scalar>* centers) const;
+
+  /**
+   * @brief 清空所有记录。
+   */
+  void clear();
+
+private:
+  template<typename Data>
+  void run(KMeans& kmeans, const Data& data, int k, Catalog* cata, double* mse);
+
+  template<typename Data>
+  void tally(const Data& data,
+             const BasicDataSet<typename Data::Scalar>& centers,
+             const Catalog& cata);
+
+  struct Record
+  {
+    Eigen::MatrixXd mCenters;  ///< 中心点
+    Eigen::VectorXd mCounts;   ///< 各类的点数
+    Eigen::VectorXd mSse;      ///< 各类的误差平方和
+    Eigen::MatrixXd mVariance; ///< 各类在各维上的方差
+  };
+
+  std::map<int, Record> mRecords;
+  mutable std::mutex mMutex;
+};
+
+} // namespace Lib
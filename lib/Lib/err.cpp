@@ -1,5 +1,9 @@
 #include "err.hpp"
 
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
 namespace Lib {
 
 using namespace std::string_literals;
@@ -22,6 +26,30 @@ Errno::info() const noexcept
 #endif
 }
 
+#ifdef _WIN32
+
+std::string
+Win32::info() const noexcept
+{
+  std::string msg(256, '\0');
+  auto len = FormatMessageA(FORMAT_MESSAGE_FROM_SYSTEM |
+                              FORMAT_MESSAGE_IGNORE_INSERTS,
+                            nullptr,
+                            _code,
+                            0,
+                            msg.data(),
+                            static_cast<DWORD>(msg.size()),
+                            nullptr);
+  if (len == 0)
+    return "Win32 error " + std::to_string(_code);
+  msg.resize(len);
+  while (!msg.empty() && (msg.back() == '\n' || msg.back() == '\r'))
+    msg.pop_back();
+  return msg;
+}
+
+#endif
+
 } // namespace err
 
 } // namespace Lib
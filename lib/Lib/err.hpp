@@ -142,6 +142,31 @@ public:
   ///@}
 };
 
+#ifdef _WIN32
+
+/**
+ * @brief Win32 API 的错误，错误码来自 GetLastError()，与 errno 的取值不同。
+ */
+class Win32 : public Err
+{
+public:
+  unsigned long _code;
+
+public:
+  Win32(unsigned long code)
+    : _code(code)
+  {
+  }
+
+public:
+  ///@name Err interface
+  ///@{
+  std::string info() const noexcept override;
+  ///@}
+};
+
+#endif
+
 } // namespace err
 
 } // namespace Lib
@@ -0,0 +1,329 @@
+#include "kernels.hpp"
+#include <algorithm>
+
+namespace Lib::kernels {
+
+namespace {
+
+using Scalar = DataSet::value_type;
+
+constexpr int kPointTile = 256; ///< 矩阵乘法分配中每块的点数
+constexpr int kCenterTile = 64; ///< 矩阵乘法分配中每块的中心数
+
+/**
+ * @brief 矩阵乘法分配的实现，tile(begin, n, buf) 返回从 begin 开始的 n 个点，
+ * 必要时使用 buf 作为存储。
+ */
+template<typename _Scalar, typename Tile>
+double
+gemm(int dataNums,
+     Tile&& tile,
+     const BasicDataSet<_Scalar>& centers,
+     Catalog& labels)
+{
+  using Scalar = _Scalar;
+
+  int k = centers.cols();
+
+  Eigen::Matrix<Scalar, Eigen::Dynamic, 1> cnorms =
+    centers.colwise().squaredNorm().transpose();
+
+  int tiles = (dataNums + kPointTile - 1) / kPointTile;
+  double sse = 0;
+#pragma omp parallel for schedule(dynamic) reduction(+ : sse)
+  for (int t = 0; t < tiles; ++t) {
+    int begin = t * kPointTile;
+    int np = std::min(kPointTile, dataNums - begin);
+    BasicDataSet<Scalar> buf;
+    BasicDataView<Scalar> points = tile(begin, np, buf);
+    auto tileLabels = labels.segment(begin, np);
+
+    Eigen::Matrix<Scalar, Eigen::Dynamic, 1> minDist(np);
+    minDist.setConstant(std::numeric_limits<Scalar>::max());
+
+    Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic> dots(kCenterTile,
+                                                               np);
+    for (int c = 0; c < k; c += kCenterTile) {
+      int nc = std::min(kCenterTile, k - c);
+      dots.topRows(nc).noalias() =
+        centers.middleCols(c, nc).transpose() * points;
+
+      for (int i = 0; i < np; ++i) {
+        for (int j = 0; j < nc; ++j) {
+          auto dist = cnorms(c + j) - 2 * dots(j, i);
+          if (dist < minDist(i))
+            minDist(i) = dist, tileLabels(i) = c + j;
+        }
+      }
+    }
+
+    for (int i = 0; i < np; ++i) {
+      auto dist = (points.col(i) - centers.col(tileLabels(i))).norm();
+      sse += double(dist) / dataNums;
+    }
+  }
+  return sse;
+}
+
+/**
+ * @brief 朴素分配的实现，比较距离平方，只对最近者开方。
+ */
+template<typename Data>
+double
+lloyd(const Data& data, const CentersOf<Data>& centers, Catalog& labels)
+{
+  using Scalar = typename Data::Scalar;
+  int k = centers.cols();
+  int dataNums = data.cols();
+
+  // 维数固定时中心点也按固定行数存放，每列的坐标可以直接装入寄存器
+  Eigen::Matrix<Scalar, kDims<Data>, Eigen::Dynamic> ctrs = centers;
+
+  double sse = 0;
+#pragma omp parallel for reduction(+ : sse)
+  for (int i = 0; i < dataNums; ++i) {
+    auto minDist = std::numeric_limits<Scalar>::max();
+    int minIdx = -1;
+    for (int j = 0; j < k; j++) {
+      auto dist = (data.col(i) - ctrs.col(j)).squaredNorm();
+      if (dist < minDist)
+        minDist = dist, minIdx = j;
+    }
+    labels(i) = minIdx;
+    assert(minIdx != -1);
+    // 在加之前先除，防止数据过大而溢出
+    sse += std::sqrt(double(minDist)) / dataNums;
+  }
+  return sse;
+}
+
+} // namespace
+
+Random
+make_random(unsigned seed)
+{
+  static thread_local Random stRand{ std::random_device()() };
+  return Random(seed ? seed : stRand());
+}
+
+double
+assign_lloyd(const DataView& data, const DataSet& centers, Catalog& labels)
+{
+  return lloyd(data, centers, labels);
+}
+
+double
+assign_lloyd(const F64DataView& data,
+             const F64DataSet& centers,
+             Catalog& labels)
+{
+  return lloyd(data, centers, labels);
+}
+
+template<int D, typename _Scalar>
+double
+assign_lloyd(const FixedView<D, _Scalar>& data,
+             const BasicDataSet<_Scalar>& centers,
+             Catalog& labels)
+{
+  return lloyd(data, centers, labels);
+}
+
+double
+assign_gemm(const DataView& data, const DataSet& centers, Catalog& labels)
+{
+  return gemm(
+    data.cols(),
+    [&](int begin, int n, DataSet&) { return data.middleCols(begin, n); },
+    centers,
+    labels);
+}
+
+double
+assign_gemm(const F64DataView& data,
+            const F64DataSet& centers,
+            Catalog& labels)
+{
+  return gemm(
+    data.cols(),
+    [&](int begin, int n, F64DataSet&) { return data.middleCols(begin, n); },
+    centers,
+    labels);
+}
+
+template<typename Code>
+double
+assign_lloyd(const Quantized<Code>& data,
+             const DataSet& centers,
+             Catalog& labels)
+{
+  int k = centers.cols();
+  int dims = data.rows();
+  int dataNums = data.cols();
+
+  // 将偏移量移到中心点上，每个点解码时只需乘以缩放系数
+  DataSet shifted = centers.colwise() - data.offset();
+
+  double sse = 0;
+#pragma omp parallel reduction(+ : sse)
+  {
+    Eigen::Matrix<Scalar, Eigen::Dynamic, 1> point(dims);
+#pragma omp for
+    for (int i = 0; i < dataNums; ++i) {
+      point =
+        data.codes().col(i).template cast<Scalar>().cwiseProduct(data.scale());
+      auto minDist = std::numeric_limits<Scalar>::max();
+      int minIdx = -1;
+      for (int j = 0; j < k; j++) {
+        auto dist = (point - shifted.col(j)).squaredNorm();
+        if (dist < minDist)
+          minDist = dist, minIdx = j;
+      }
+      labels(i) = minIdx;
+      assert(minIdx != -1);
+      sse += std::sqrt(double(minDist)) / dataNums;
+    }
+  }
+  return sse;
+}
+
+template<typename Code>
+double
+assign_gemm(const Quantized<Code>& data,
+            const DataSet& centers,
+            Catalog& labels)
+{
+  return gemm(
+    data.cols(),
+    [&](int begin, int n, DataSet& buf) {
+      data.decode(begin, n, &buf);
+      return DataView(buf);
+    },
+    centers,
+    labels);
+}
+
+template<typename Code>
+double
+exact_mse(const Quantized<Code>& data,
+          const DataSet& centers,
+          const Catalog& labels)
+{
+  Eigen::VectorXd scale = data.scale().template cast<double>();
+  Eigen::VectorXd offset = data.offset().template cast<double>();
+  int dataNums = data.cols();
+
+  double sse = 0;
+#pragma omp parallel for reduction(+ : sse)
+  for (int i = 0; i < dataNums; ++i) {
+    auto point =
+      data.codes().col(i).template cast<double>().cwiseProduct(scale) + offset;
+    sse += (point - centers.col(labels(i)).cast<double>()).norm() / dataNums;
+  }
+  return sse;
+}
+
+void
+Accumulator::operator()(const DataView& data, const Catalog& labels, int k)
+{
+  accumulate(data, labels, k);
+}
+
+void
+Accumulator::operator()(const F64DataView& data, const Catalog& labels, int k)
+{
+  accumulate(data, labels, k);
+}
+
+template<int D, typename _Scalar>
+void
+Accumulator::operator()(const FixedView<D, _Scalar>& data,
+                        const Catalog& labels,
+                        int k)
+{
+  accumulate(data, labels, k);
+}
+
+template<typename Code>
+void
+Accumulator::operator()(const Quantized<Code>& data,
+                        const Catalog& labels,
+                        int k)
+{
+  accumulate(data, labels, k);
+}
+
+template<typename Data>
+void
+Accumulator::accumulate(const Data& data, const Catalog& labels, int k)
+{
+  int dims = data.rows();
+  int dataNums = data.cols();
+  int slots = std::clamp(dataNums / kMinSlotPoints, 1, kMaxSlots);
+
+  mSums.resize(slots);
+  mCounts.resize(slots);
+
+#pragma omp parallel for schedule(static)
+  for (int s = 0; s < slots; ++s) {
+    // 维数固定时在同样固定行数的矩阵中累加，使每次累加都在编译期展开
+    Eigen::Matrix<double, kDims<Data>, Eigen::Dynamic> sums;
+    auto& counts = mCounts[s];
+    sums.setZero(dims, k);
+    counts.setZero(k);
+
+    int end = std::int64_t(dataNums) * (s + 1) / slots;
+    for (int i = std::int64_t(dataNums) * s / slots; i < end; ++i) {
+      int tmp = labels(i);
+      sums.col(tmp) += data.col(i).template cast<double>();
+      ++counts(tmp);
+    }
+    mSums[s] = sums;
+  }
+
+  for (int stride = 1; stride < slots; stride *= 2) {
+#pragma omp parallel for schedule(static)
+    for (int s = 0; s < slots - stride; s += stride * 2) {
+      mSums[s] += mSums[s + stride];
+      mCounts[s] += mCounts[s + stride];
+    }
+  }
+}
+
+#define LIB_INSTANTIATE(Code)                                                  \
+  template double assign_lloyd(                                                \
+    const Quantized<Code>&, const DataSet&, Catalog&);                         \
+  template double assign_gemm(                                                 \
+    const Quantized<Code>&, const DataSet&, Catalog&);                         \
+  template double exact_mse(                                                   \
+    const Quantized<Code>&, const DataSet&, const Catalog&);                   \
+  template void Accumulator::operator()(                                       \
+    const Quantized<Code>&, const Catalog&, int);
+
+LIB_INSTANTIATE(std::int8_t)
+LIB_INSTANTIATE(Eigen::half)
+LIB_INSTANTIATE(Eigen::bfloat16)
+
+#undef LIB_INSTANTIATE
+
+#define LIB_INSTANTIATE(D, Scalar)                                             \
+  template double assign_lloyd(const FixedView<D, Scalar>&,                    \
+                               const BasicDataSet<Scalar>&,                    \
+                               Catalog&);                                      \
+  template void Accumulator::operator()(                                       \
+    const FixedView<D, Scalar>&, const Catalog&, int);
+
+LIB_INSTANTIATE(2, float)
+LIB_INSTANTIATE(3, float)
+LIB_INSTANTIATE(4, float)
+LIB_INSTANTIATE(8, float)
+LIB_INSTANTIATE(16, float)
+LIB_INSTANTIATE(2, double)
+LIB_INSTANTIATE(3, double)
+LIB_INSTANTIATE(4, double)
+LIB_INSTANTIATE(8, double)
+LIB_INSTANTIATE(16, double)
+
+#undef LIB_INSTANTIATE
+
+} // namespace Lib::kernels
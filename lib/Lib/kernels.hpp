@@ -0,0 +1,201 @@
+/**
+ * @brief 这个文件为 K-Means 各步骤的计算内核，供不同的聚类实现共用
+ */
+
+#pragma once
+
+#include "Quantized.hpp"
+#include "lib.hpp"
+#include <random>
+
+namespace Lib::kernels {
+
+using Random = std::default_random_engine;
+
+/**
+ * @brief 以 seed 为种子构造随机数引擎，seed 为 0 时随机生成种子。
+ */
+Random
+make_random(unsigned seed);
+
+/**
+ * @brief 数据集 Data 上的中心点矩阵，标量类型与数据集（解码后）相同。
+ */
+template<typename Data>
+using CentersOf = BasicDataSet<typename Data::Scalar>;
+
+/**
+ * @brief 维数在编译期固定为 D 的数据集只读视图。
+ *
+ * 以它为数据集时，逐点的距离计算和累加在编译期完全展开，一个点的坐标可以
+ * 全部放在寄存器中，省去动态大小的表达式在小维数下的循环开销。
+ */
+template<int D, typename _Scalar = DataSet::value_type>
+using FixedView = Eigen::Map<const Eigen::Matrix<_Scalar, D, Eigen::Dynamic>>;
+
+/**
+ * @brief 数据集类型在编译期的维数，非 FixedView 时为 Eigen::Dynamic。
+ */
+template<typename Data>
+constexpr int kDims = Eigen::Dynamic;
+
+template<int D, typename _Scalar>
+constexpr int kDims<FixedView<D, _Scalar>> = D;
+
+/**
+ * @brief 按维数分派：数据集的维数为 2、3、4、8 或 16 且各列连续存放时，以
+ * 对应的 FixedView 调用 fn，否则以 data 本身调用。
+ */
+template<typename _Scalar, typename Fn>
+void
+dispatch_dims(const BasicDataView<_Scalar>& data, Fn&& fn)
+{
+  if (data.outerStride() == data.rows()) {
+    auto* p = data.data();
+    switch (data.rows()) {
+      case 2:
+        return fn(FixedView<2, _Scalar>(p, 2, data.cols()));
+      case 3:
+        return fn(FixedView<3, _Scalar>(p, 3, data.cols()));
+      case 4:
+        return fn(FixedView<4, _Scalar>(p, 4, data.cols()));
+      case 8:
+        return fn(FixedView<8, _Scalar>(p, 8, data.cols()));
+      case 16:
+        return fn(FixedView<16, _Scalar>(p, 16, data.cols()));
+    }
+  }
+  fn(data);
+}
+
+/**
+ * @brief 朴素分配：对数据集中每个点，计算其到所有中心点的距离找到最近者。
+ *
+ * @return 平均距离
+ */
+double
+assign_lloyd(const DataView& data, const DataSet& centers, Catalog& labels);
+
+/**
+ * @brief double 精度版。
+ */
+double
+assign_lloyd(const F64DataView& data,
+             const F64DataSet& centers,
+             Catalog& labels);
+
+/**
+ * @brief 固定维数版，中心点先拷贝为同样固定行数的矩阵。
+ */
+template<int D, typename _Scalar>
+double
+assign_lloyd(const FixedView<D, _Scalar>& data,
+             const BasicDataSet<_Scalar>& centers,
+             Catalog& labels);
+
+/**
+ * @brief 矩阵乘法形式的分配。
+ *
+ * 将距离平方展开为 ||x||² - 2·cᵀx + ||c||²，按“点块 × 中心块”分块，用 Eigen
+ * 的矩阵乘法计算 cᵀx，使中心点在块内被多个点复用。||x||² 对同一点是常数，
+ * 比较时可以省去；只对每个点最终所属的中心精确计算一次距离，用于误差统计。
+ *
+ * @return 平均距离
+ */
+double
+assign_gemm(const DataView& data, const DataSet& centers, Catalog& labels);
+
+/**
+ * @brief double 精度版。
+ */
+double
+assign_gemm(const F64DataView& data,
+            const F64DataSet& centers,
+            Catalog& labels);
+
+/**
+ * @brief 量化数据集上的朴素分配，直接在编码上计算距离。
+ *
+ * 将偏移量移到中心点上，距离平方为 Σ (scale · q - (c - offset))²。每个点的
+ * 编码只读取一次，乘以缩放系数后与所有中心比较，内存带宽按编码的大小计。
+ *
+ * @return 平均距离，按 float 精度计算
+ */
+template<typename Code>
+double
+assign_lloyd(const Quantized<Code>& data,
+             const DataSet& centers,
+             Catalog& labels);
+
+/**
+ * @brief 量化数据集上的矩阵乘法分配，每块点先解码为 float 再做矩阵乘法。
+ *
+ * @return 平均距离
+ */
+template<typename Code>
+double
+assign_gemm(const Quantized<Code>& data,
+            const DataSet& centers,
+            Catalog& labels);
+
+/**
+ * @brief 以 double 精度解码并计算每个点到所属中心的平均距离。
+ */
+template<typename Code>
+double
+exact_mse(const Quantized<Code>& data,
+          const DataSet& centers,
+          const Catalog& labels);
+
+/**
+ * @brief 更新步骤的累加器，按类别累加数据点，得到各类的坐标和与点数。
+ *
+ * 数据集被切为固定数目的连续段，每段在私有的槽中顺序累加，再两两树形归约，
+ * 线程之间不共享写入的内存。切分方式只与数据量有关而与线程数无关，因此累加
+ * 结果不随线程数变化。
+ */
+class Accumulator
+{
+public:
+  static constexpr int kMaxSlots = 64;        ///< 槽数上限
+  static constexpr int kMinSlotPoints = 4096; ///< 每个槽至少累加的点数
+
+public:
+  /**
+   * @brief 累加，结果为 sums() 和 counts()。
+   */
+  void operator()(const DataView& data, const Catalog& labels, int k);
+
+  /**
+   * @brief double 精度版。
+   */
+  void operator()(const F64DataView& data, const Catalog& labels, int k);
+
+  /**
+   * @brief 固定维数版。
+   */
+  template<int D, typename _Scalar>
+  void operator()(const FixedView<D, _Scalar>& data,
+                  const Catalog& labels,
+                  int k);
+
+  /**
+   * @brief 累加量化数据集解码后的值。
+   */
+  template<typename Code>
+  void operator()(const Quantized<Code>& data, const Catalog& labels, int k);
+
+  const Eigen::MatrixXd& sums() const { return mSums[0]; }
+
+  const Eigen::VectorXi& counts() const { return mCounts[0]; }
+
+private:
+  template<typename Data>
+  void accumulate(const Data& data, const Catalog& labels, int k);
+
+private:
+  std::vector<Eigen::MatrixXd> mSums;
+  std::vector<Eigen::VectorXi> mCounts;
+};
+
+} // namespace Lib::kernels
@@ -1,9 +1,12 @@
 #include "lib.hpp"
+#include <cstdlib>
+#include <memory>
 
 namespace Lib {
 
+template<typename _Scalar>
 bj::value
-MseHistory::to_json() const
+BasicMseHistory<_Scalar>::to_json() const
 {
   bj::array arr;
   for (const auto& p : *this) {
@@ -15,4 +18,290 @@ MseHistory::to_json() const
   return std::move(arr);
 }
 
+template class BasicMseHistory<float>;
+template class BasicMseHistory<double>;
+
+namespace {
+
+template<typename T>
+void
+byteswap(T& t)
+{
+  auto* p = reinterpret_cast<unsigned char*>(&t);
+  std::reverse(p, p + sizeof(T));
+}
+
+constexpr std::int64_t kDirectAlign = CFile64::kDirectAlign;
+
+std::int64_t
+align_down(std::int64_t x)
+{
+  return x / kDirectAlign * kDirectAlign;
+}
+
+std::int64_t
+align_up(std::int64_t x)
+{
+  return align_down(x + kDirectAlign - 1);
+}
+
+struct AlignedFree
+{
+  void operator()(char* p) const noexcept
+  {
+#ifdef _WIN32
+    _aligned_free(p);
+#else
+    std::free(p);
+#endif
+  }
+};
+
+/**
+ * @brief 对齐到 kDirectAlign 的中转缓冲区，供直接 I/O 使用。
+ */
+using Bounce = std::unique_ptr<char, AlignedFree>;
+
+Bounce
+make_bounce(std::int64_t bytes) noexcept(false)
+{
+#ifdef _WIN32
+  auto* p = _aligned_malloc(bytes, kDirectAlign);
+#else
+  auto* p = std::aligned_alloc(kDirectAlign, bytes);
+#endif
+  if (p == nullptr)
+    throw std::bad_alloc();
+  return Bounce(static_cast<char*>(p));
+}
+
+/**
+ * @brief 将 [addr, addr + bytes) 切为起点对齐的请求，由多个线程共用 file
+ * 并行执行，request(lo, hi, bounce) 处理其中的 [lo, hi)。
+ *
+ * 直接 I/O 时每个线程持有一个能容纳整个请求的中转缓冲区。线程中的异常在并行
+ * 区域结束后重新抛出。
+ */
+template<typename Request>
+void
+parallel_requests(std::int64_t addr,
+                  std::int64_t bytes,
+                  const MatxIO& io,
+                  Request&& request) noexcept(false)
+{
+  if (bytes <= 0)
+    return;
+
+  auto size = align_up(std::max<std::int64_t>(io.mRequestBytes, 1));
+  auto first = align_down(addr), last = addr + bytes;
+  std::int64_t n = (last - first + size - 1) / size;
+
+  std::exception_ptr error;
+#pragma omp parallel if (n > 1)
+  {
+    Bounce bounce;
+
+#pragma omp for schedule(dynamic)
+    for (std::int64_t i = 0; i < n; ++i) {
+      try {
+        if (io.mDirect && !bounce)
+          bounce = make_bounce(size);
+        auto lo = std::max(first + i * size, addr);
+        auto hi = std::min(first + (i + 1) * size, last);
+        request(lo, hi, bounce.get());
+      } catch (...) {
+#pragma omp critical(matx_io)
+        if (!error)
+          error = std::current_exception();
+      }
+    }
+  }
+
+  if (error)
+    std::rethrow_exception(error);
+}
+
+} // namespace
+
+void
+matx_pread(const CFile64& file,
+           std::int64_t addr,
+           std::int64_t bytes,
+           void* buffer,
+           const MatxIO& io) noexcept(false)
+{
+  auto* out = static_cast<char*>(buffer) - addr;
+  auto size = align_up(std::max<std::int64_t>(io.mRequestBytes, 1));
+  auto request = [&](std::int64_t lo, std::int64_t hi, char* bounce) {
+    // 请求大致按顺序被领取，提前提示下一轮的请求
+    if (io.mReadahead && !io.mDirect)
+      file.readahead(align_down(lo) + size * omp_get_num_threads(), size);
+
+    if (!io.mDirect) {
+      if (file.pread(out + lo, hi - lo, lo) != hi - lo)
+        throw err::Lit("unexpected end of matx file.");
+      return;
+    }
+
+    auto alo = align_down(lo), ahi = align_up(hi);
+    if (file.pread(bounce, ahi - alo, alo) < hi - alo)
+      throw err::Lit("unexpected end of matx file.");
+    std::memcpy(out + lo, bounce + (lo - alo), hi - lo);
+  };
+
+  if (io.mReadahead && !io.mDirect)
+    file.readahead(addr, std::min(bytes, size * omp_get_max_threads()));
+  parallel_requests(addr, bytes, io, request);
+}
+
+void
+matx_pwrite(const CFile64& file,
+            std::int64_t addr,
+            std::int64_t bytes,
+            const void* buffer,
+            const MatxIO& io) noexcept(false)
+{
+  auto* in = static_cast<const char*>(buffer) - addr;
+  auto request = [&](std::int64_t lo, std::int64_t hi, char* bounce) {
+    if (!io.mDirect) {
+      file.pwrite(in + lo, hi - lo, lo);
+      return;
+    }
+
+    // 只有首尾的请求可能不对齐，保留块中原有的内容
+    auto alo = align_down(lo), ahi = align_up(hi);
+    if (alo != lo || ahi != hi) {
+      std::memset(bounce, 0, ahi - alo);
+      file.pread(bounce, ahi - alo, alo);
+    }
+    std::memcpy(bounce + (lo - alo), in + lo, hi - lo);
+    file.pwrite(bounce, ahi - alo, alo);
+  };
+
+  parallel_requests(addr, bytes, io, request);
+}
+
+CFile64
+matx_open(const char* path,
+          const MatxIO& io,
+          MatxHeader* header,
+          std::vector<MatxChunk>* chunks,
+          CFile64::Closers* files) noexcept(false)
+{
+  // 文件头和分块表较小，总是经过缓冲读取
+  CFile64 file(path, "rb");
+  files->push_back(file);
+  header->read(file);
+  *chunks = header->read_chunks(file);
+
+  if (io.mDirect) {
+    file = CFile64::open_direct(path, "rb");
+    files->push_back(file);
+  }
+  return file;
+}
+
+std::int64_t
+MatxHeader::read(const CFile64& file) noexcept(false)
+{
+  file.seek(0, SEEK_SET);
+  file >> mMagic;
+
+  auto swapped = kMagic;
+  byteswap(swapped);
+  if (mMagic != kMagic && mMagic != swapped) {
+    // 旧格式，读到的“魔数”实际是行数，元素宽度由文件大小推断
+    std::uint32_t cols;
+    file >> cols;
+    mRows = mMagic, mCols = cols;
+    mMagic = kMagic, mVersion = 0, mDType = DType::kF32;
+
+    file.seek(0, SEEK_END);
+    auto bytes = std::uint64_t(file.tell()) - offset();
+    if (mRows * mCols != 0 && bytes == mRows * mCols * sizeof(double))
+      mDType = DType::kF64;
+    file.seek(offset(), SEEK_SET);
+    return offset();
+  }
+
+  // 字节反转的魔数说明文件与本机的字节序不同
+  bool foreign = mMagic == swapped;
+  file >> mVersion >> mDType >> mReserved >> mRows >> mCols;
+  if (foreign) {
+    mMagic = kMagic;
+    byteswap(mVersion), byteswap(mRows), byteswap(mCols);
+  }
+
+  if (mVersion == 1) {
+    mLayout = Layout::kColMajor, mEndian = native_endian();
+    if (foreign)
+      mEndian = mEndian == Endian::kLittle ? Endian::kBig : Endian::kLittle;
+    mChunks = 0, mOffset = offset();
+    return offset();
+  }
+  if (mVersion != 2)
+    throw err::Lit("unsupported matx version.");
+
+  file >> mLayout >> mEndian >> mReserved2 >> mChunks >> mOffset;
+  if (foreign)
+    byteswap(mChunks), byteswap(mOffset);
+  if (mOffset < sizeof(MatxHeader) + sizeof(MatxChunk) * mChunks)
+    throw err::Lit("corrupted matx header.");
+  file.seek(mOffset, SEEK_SET);
+  return mOffset;
+}
+
+std::vector<MatxChunk>
+MatxHeader::read_chunks(const CFile64& file) const noexcept(false)
+{
+  if (mVersion < 2 || mChunks == 0)
+    return {};
+
+  std::vector<MatxChunk> chunks(mChunks);
+  CFile64::Seeker seeker(file, sizeof(MatxHeader), SEEK_SET);
+  file.read(chunks.data(), sizeof(MatxChunk), chunks.size());
+  if (mEndian != native_endian())
+    for (auto& chunk : chunks)
+      byteswap(chunk.mBegin), byteswap(chunk.mOffset);
+
+  // 各块的起点须从 0 开始严格递增，且都在数据区内
+  for (std::size_t i = 0; i < chunks.size(); ++i) {
+    auto begin = chunks[i].mBegin;
+    if ((i ? begin <= chunks[i - 1].mBegin : begin != 0) ||
+        begin >= outer() || chunks[i].mOffset < mOffset)
+      throw err::Lit("corrupted matx chunk table.");
+  }
+  return chunks;
+}
+
+std::vector<MatxChunk>
+MatxHeader::make_chunks(std::size_t width) noexcept
+{
+  auto stride = width * (mLayout == Layout::kColMajor ? mRows : mCols);
+  std::uint64_t per = 1, n = 0;
+  if (stride != 0 && outer() != 0) {
+    per = std::max<std::uint64_t>(1, kChunkBytes / stride);
+    n = (outer() + per - 1) / per;
+  }
+
+  mChunks = n;
+  mOffset = sizeof(MatxHeader) + sizeof(MatxChunk) * n;
+  mOffset = (mOffset + kAlign - 1) / kAlign * kAlign;
+
+  std::vector<MatxChunk> chunks(n);
+  for (std::uint64_t i = 0; i < n; ++i)
+    chunks[i] = { i * per, mOffset + i * per * stride };
+  return chunks;
+}
+
+MatxHeader
+MatxHeader::peek(const char* path) noexcept(false)
+{
+  CFile64 file(path, "rb");
+  CFile64::Closer closer(file);
+  MatxHeader header;
+  header.read(file);
+  return header;
+}
+
 } // namespace Lib
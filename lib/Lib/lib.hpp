@@ -4,8 +4,12 @@
 #include "cpp"
 #include "err.hpp"
 #include <Eigen/Dense>
+#include <algorithm>
 #include <boost/json.hpp>
+#include <cstddef>
+#include <cstring>
 #include <omp.h>
+#include <type_traits>
 #include <vector>
 
 namespace Lib {
@@ -13,9 +17,28 @@ namespace Lib {
 namespace bj = boost::json;
 
 /**
- * @brief 数据集，每列是一个数据点，列号为 ID。
+ * @brief 标量类型为 _Scalar 的数据集，每列是一个数据点，列号为 ID。
  */
-using DataSet = Eigen::MatrixXf;
+template<typename _Scalar>
+using BasicDataSet = Eigen::Matrix<_Scalar, Eigen::Dynamic, Eigen::Dynamic>;
+
+/**
+ * @brief 数据集的只读视图，可以不经拷贝地引用数据集或内存映射的数据集。
+ */
+template<typename _Scalar>
+using BasicDataView = Eigen::Ref<const BasicDataSet<_Scalar>>;
+
+/**
+ * @brief 数据集，默认为 float 精度。
+ */
+using DataSet = BasicDataSet<float>;
+using DataView = BasicDataView<float>;
+
+/**
+ * @brief double 精度的数据集。
+ */
+using F64DataSet = BasicDataSet<double>;
+using F64DataView = BasicDataView<double>;
 
 /**
  * @brief 聚类结果，一个列向量，每行的整数是数据集对应列的类别号。
@@ -23,19 +46,21 @@ using DataSet = Eigen::MatrixXf;
 using Catalog = Eigen::VectorXi;
 
 /**
- * @brief 误差历史，两列向量，第一列是聚类数，第二列是对应的误差。
+ * @brief 误差历史，两列向量，第一列是聚类数，第二列是对应的误差，误差的精度
+ * 与数据集相同。
  */
-class MseHistory
-  : public std::vector<std::pair<Catalog::value_type, DataSet::value_type>>
+template<typename _Scalar>
+class BasicMseHistory
+  : public std::vector<std::pair<Catalog::value_type, _Scalar>>
 {
-  using _T = MseHistory;
-  using _S = std::vector<std::pair<Catalog::value_type, DataSet::value_type>>;
+  using _T = BasicMseHistory;
+  using _S = std::vector<std::pair<Catalog::value_type, _Scalar>>;
 
 public:
   using _S::_S;
 
 public:
-  static MseHistory from_json(const bj::value& json); // TODO 用不到，暂时不做
+  static _T from_json(const bj::value& json); // TODO 用不到，暂时不做
 
 public:
   /**
@@ -54,6 +79,12 @@ public:
   bj::value to_json() const;
 };
 
+using MseHistory = BasicMseHistory<float>;
+using F64MseHistory = BasicMseHistory<double>;
+
+extern template class BasicMseHistory<float>;
+extern template class BasicMseHistory<double>;
+
 template<typename _Scalar, int _Rows = -1, int _Cols = -1>
 static Eigen::Matrix<_Scalar, _Rows, _Cols>
 json_to_matx(const bj::value& json)
@@ -108,73 +139,378 @@ matx_to_json(const Eigen::Matrix<_Scalar, _Rows, _Cols>& matx)
 }
 
 /**
- * @brief 将数据集以二进制格式保存到文件，使用多线程并行加速。
+ * @brief matx 二进制文件中数据的一块。
+ *
+ * 数据按外层下标（按列存储时为列号）切块，块内连续存放，读取时可以直接定位到
+ * 某个外层下标范围，也可以各块并行读取。
+ */
+struct MatxChunk
+{
+  std::uint64_t mBegin;  ///< 块的第一个外层下标
+  std::uint64_t mOffset; ///< 块在文件中的起始偏移
+};
+
+/**
+ * @brief 带数据类型的 matx 二进制文件头。
+ *
+ * 版本 2 的文件头之后是 mChunks 项 MatxChunk 组成的分块表（可以为空），数据
+ * 从对齐到 kAlign 的 mOffset 开始，便于内存映射和向量化访问。文件头、分块表和
+ * 数据均按 mEndian 的字节序存放，读到字节反转的魔数时整个文件头随之反转。
+ *
+ * 版本 1 的文件头只到 mCols 为止，数据紧随其后，按列存储、小端序。旧格式
+ * （版本记为 0）的文件头只有 uint32 的行数和列数，没有魔数，读取时据此区分，
+ * 并按文件大小推断元素的宽度。量化类型在数据之前还依次保存各维 float 的缩放
+ * 系数和偏移量。
+ */
+struct MatxHeader
+{
+  static constexpr std::uint32_t kMagic = 0x5854414d;     ///< "MATX"
+  static constexpr std::uint16_t kVersion = 2;            ///< 写入的版本
+  static constexpr std::uint64_t kAlign = 4096;           ///< 数据偏移的对齐
+  static constexpr std::uint64_t kChunkBytes = 16 << 20; ///< 每块的字节数
+
+  /**
+   * @brief 元素的数据类型。
+   */
+  enum class DType : std::uint8_t
+  {
+    kF32,  ///< float
+    kI8,   ///< int8，按维缩放和偏移
+    kF16,  ///< IEEE 半精度浮点，按维缩放和偏移
+    kBF16, ///< bfloat16，按维缩放和偏移
+    kF64,  ///< double
+    kI32,  ///< int32，如聚类结果
+  };
+
+  /**
+   * @brief 数据的存储顺序。
+   */
+  enum class Layout : std::uint8_t
+  {
+    kColMajor, ///< 按列存储，与 Eigen 的默认顺序一致
+    kRowMajor, ///< 按行存储
+  };
+
+  /**
+   * @brief 字节序。
+   */
+  enum class Endian : std::uint8_t
+  {
+    kLittle,
+    kBig,
+  };
+
+  std::uint32_t mMagic{ kMagic };
+  std::uint16_t mVersion{ kVersion }; ///< 旧格式记为 0
+  DType mDType{ DType::kF32 };
+  std::uint8_t mReserved{ 0 };
+  std::uint64_t mRows{ 0 };
+  std::uint64_t mCols{ 0 };
+  Layout mLayout{ Layout::kColMajor }; ///< 以下字段自版本 2 起
+  Endian mEndian{ native_endian() };
+  std::uint16_t mReserved2{ 0 };
+  std::uint32_t mChunks{ 0 };      ///< 分块表的项数
+  std::uint64_t mOffset{ kAlign }; ///< 数据的起始偏移
+
+  /**
+   * @brief 本机的字节序。
+   */
+  static Endian native_endian() noexcept
+  {
+    const std::uint16_t one = 1;
+    return *reinterpret_cast<const std::uint8_t*>(&one) ? Endian::kLittle
+                                                         : Endian::kBig;
+  }
+
+  /**
+   * @brief 未经量化的元素类型 _Scalar 对应的数据类型。
+   */
+  template<typename _Scalar>
+  static constexpr DType dtype_of() noexcept
+  {
+    if constexpr (std::is_same_v<_Scalar, double>)
+      return DType::kF64;
+    else if constexpr (std::is_same_v<_Scalar, std::int32_t>)
+      return DType::kI32;
+    else {
+      static_assert(std::is_same_v<_Scalar, float>, "unsupported matx dtype");
+      return DType::kF32;
+    }
+  }
+
+  /**
+   * @brief 从文件开头读取文件头，并将文件位置移到数据的起始处。旧格式的元素
+   * 按宽度视为 kF32 或 kF64。
+   *
+   * @return 数据的起始偏移
+   */
+  std::int64_t read(const CFile64& file) noexcept(false);
+
+  /**
+   * @brief 读取分块表，版本 2 以前的文件没有分块表，返回空表。
+   */
+  std::vector<MatxChunk> read_chunks(const CFile64& file) const
+    noexcept(false);
+
+  /**
+   * @brief 读取路径为 path 的文件的文件头。
+   */
+  static MatxHeader peek(const char* path) noexcept(false);
+
+  /**
+   * @brief 按每块约 kChunkBytes 字节生成分块表，相应地设置 mChunks 和
+   * mOffset。元素宽度为 width。
+   */
+  std::vector<MatxChunk> make_chunks(std::size_t width) noexcept;
+
+  /**
+   * @brief 数据的起始偏移。
+   */
+  std::int64_t offset() const noexcept
+  {
+    switch (mVersion) {
+      case 0:
+        return sizeof(std::uint32_t) * 2;
+      case 1:
+        return offsetof(MatxHeader, mLayout);
+      default:
+        return mOffset;
+    }
+  }
+
+  /**
+   * @brief 外层下标的个数，按列存储时为列数。
+   */
+  std::uint64_t outer() const noexcept
+  {
+    return mLayout == Layout::kColMajor ? mCols : mRows;
+  }
+
+  /**
+   * @brief 元素能否按 _Scalar 读取。旧格式没有记录数据类型，只比较宽度，
+   * 因此旧格式的 int32 文件也能读取。
+   */
+  template<typename _Scalar>
+  bool holds() const noexcept
+  {
+    if (mVersion == 0)
+      return (mDType == DType::kF64 ? 8 : 4) == sizeof(_Scalar);
+    return mDType == dtype_of<_Scalar>();
+  }
+
+  /**
+   * @brief 数据能否不经转换直接使用，即按列存储且字节序与本机相同。
+   */
+  bool native() const noexcept
+  {
+    return mLayout == Layout::kColMajor && mEndian == native_endian();
+  }
+};
+
+/**
+ * @brief matx 二进制文件的并行读写选项。
+ *
+ * 所有线程共用一个文件描述符，以对齐到 CFile64::kDirectAlign 的大块请求并行
+ * 调用 pread/pwrite，避免为每个线程打开文件。
+ */
+struct MatxIO
+{
+  std::int64_t mRequestBytes{ 8 << 20 }; ///< 每个请求的字节数，向上对齐
+  bool mDirect{ false };                 ///< 以直接 I/O 绕过页缓存
+  bool mReadahead{ true };               ///< 读取时提示操作系统预读
+
+  /**
+   * @brief 按 mDirect 打开文件。
+   */
+  CFile64 open(const char* path, const char* mode) const noexcept(false)
+  {
+    return mDirect ? CFile64::open_direct(path, mode) : CFile64(path, mode);
+  }
+};
+
+/**
+ * @brief 从 file 的偏移 addr 处并行读取 bytes 字节到 buffer。
+ *
+ * 直接 I/O 时各线程经过对齐的中转缓冲区读取，文件提前结束时抛出异常。
+ */
+void
+matx_pread(const CFile64& file,
+           std::int64_t addr,
+           std::int64_t bytes,
+           void* buffer,
+           const MatxIO& io) noexcept(false);
+
+/**
+ * @brief 将 buffer 中的 bytes 字节并行写入 file 的偏移 addr 处。
+ *
+ * 直接 I/O 时未对齐的首尾块先读出再改写，因此 file 须可读；文件末尾按块
+ * 补零，调用者应随后截断文件。
+ */
+void
+matx_pwrite(const CFile64& file,
+            std::int64_t addr,
+            std::int64_t bytes,
+            const void* buffer,
+            const MatxIO& io) noexcept(false);
+
+/**
+ * @brief 打开 matx 文件并读取文件头和分块表。
+ *
+ * @param files 打开的文件，由调用者负责关闭
+ * @return 用于读取数据的文件，直接 I/O 时为另行打开的文件
+ */
+CFile64
+matx_open(const char* path,
+          const MatxIO& io,
+          MatxHeader* header,
+          std::vector<MatxChunk>* chunks,
+          CFile64::Closers* files) noexcept(false);
+
+/**
+ * @brief 反转 n 个元素各自的字节序。
+ */
+template<typename T>
+void
+matx_byteswap(T* data, std::int64_t n)
+{
+#pragma omp parallel for
+  for (std::int64_t i = 0; i < n; ++i) {
+    auto* p = reinterpret_cast<unsigned char*>(data + i);
+    std::reverse(p, p + sizeof(T));
+  }
+}
+
+/**
+ * @brief 将数据集以二进制格式保存到文件，文件头中记录元素的数据类型，使用
+ * 多线程并行加速。
+ *
+ * 文件头和分块表补齐到数据的起始偏移，与数据一样以对齐的请求写入。
  *
  * @param path 文件路径
  */
 template<typename _Scalar, int _Rows, int _Cols>
 void
 matx_dump_bin(const Eigen::Matrix<_Scalar, _Rows, _Cols>& matx,
-              const char* path)
+              const char* path,
+              const MatxIO& io = {})
 {
-  {
-    CFile64 file(path, "wb");
-    CFile64::Closer closer(file);
-    std::uint32_t rows = matx.rows(), cols = matx.cols();
-    file.write(&rows, sizeof(std::uint32_t), 1);
-    file.write(&cols, sizeof(std::uint32_t), 1);
-  }
+  MatxHeader header;
+  header.mDType = MatxHeader::dtype_of<_Scalar>();
+  header.mRows = matx.rows(), header.mCols = matx.cols();
+  auto chunks = header.make_chunks(sizeof(_Scalar));
 
-  std::int64_t size = matx.size();
-#pragma omp parallel
-  {
-    auto tid = omp_get_thread_num();
-    auto tnum = omp_get_num_threads();
+  std::vector<char> head(header.offset());
+  std::memcpy(head.data(), &header, sizeof(header));
+  std::memcpy(head.data() + sizeof(header),
+              chunks.data(),
+              sizeof(MatxChunk) * chunks.size());
 
-    auto begin = size * tid / tnum;
-    auto tsize = size * (tid + 1) / tnum - begin;
+  auto file = io.open(path, "w+b");
+  CFile64::Closer closer(file);
+  std::int64_t bytes = sizeof(_Scalar) * matx.size();
+  matx_pwrite(file, 0, head.size(), head.data(), io);
+  matx_pwrite(file, header.offset(), bytes, matx.data(), io);
+  file.trunc(header.offset() + bytes);
+}
 
-    CFile64 file(path, "r+b");
-    CFile64::Closer closer(file);
+/**
+ * @brief 读取外层下标 [begin, end) 的数据到 out，不做字节序和存储顺序的转换。
+ *
+ * 数据在文件中连续存放，有分块表时用它定位 begin 所在的位置。
+ */
+template<typename _Scalar>
+void
+matx_read_outer(const CFile64& file,
+                const MatxHeader& header,
+                const std::vector<MatxChunk>& chunks,
+                std::uint64_t begin,
+                std::uint64_t end,
+                _Scalar* out,
+                const MatxIO& io)
+{
+  std::int64_t stride = header.mLayout == MatxHeader::Layout::kColMajor
+                          ? header.mRows
+                          : header.mCols;
 
-    file.seek(sizeof(std::uint32_t) * 2 + sizeof(_Scalar) * begin, SEEK_SET);
-    file.write(matx.data() + begin, sizeof(_Scalar), tsize);
+  std::int64_t offset = header.offset() + sizeof(_Scalar) * stride * begin;
+  if (!chunks.empty()) {
+    auto it = std::upper_bound(
+      chunks.begin(),
+      chunks.end(),
+      begin,
+      [](std::uint64_t k, const MatxChunk& c) { return k < c.mBegin; });
+    --it;
+    offset = it->mOffset + sizeof(_Scalar) * stride * (begin - it->mBegin);
   }
+
+  matx_pread(file, offset, sizeof(_Scalar) * stride * (end - begin), out, io);
 }
 
 /**
  * @brief 从二进制文件中加载数据集，使用多线程并行加速。
  *
+ * 按行存储或字节序与本机不同的文件在读入后转换。
+ *
  * @param path 文件路径
  */
 template<typename _Scalar, int _Rows, int _Cols>
 void
-matx_load_bin(Eigen::Matrix<_Scalar, _Rows, _Cols>* matx, const char* path)
+matx_load_bin(Eigen::Matrix<_Scalar, _Rows, _Cols>* matx,
+              const char* path,
+              const MatxIO& io = {})
 {
-  std::uint32_t rows, cols;
-  {
-    CFile64 file(path, "rb");
-    CFile64::Closer closer(file);
-    file.read(&rows, sizeof(std::uint32_t), 1);
-    file.read(&cols, sizeof(std::uint32_t), 1);
+  MatxHeader header;
+  std::vector<MatxChunk> chunks;
+  CFile64::Closers files;
+  auto file = matx_open(path, io, &header, &chunks, &files);
+  if (!header.holds<_Scalar>())
+    throw err::Lit("mismatched matx dtype.");
+
+  auto outer = header.outer();
+  matx->resize(header.mRows, header.mCols);
+  if (header.mLayout == MatxHeader::Layout::kColMajor)
+    matx_read_outer(file, header, chunks, 0, outer, matx->data(), io);
+  else {
+    Eigen::Matrix<_Scalar, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
+      rowMajor(header.mRows, header.mCols);
+    matx_read_outer(file, header, chunks, 0, outer, rowMajor.data(), io);
+    *matx = rowMajor;
   }
-  matx->resize(rows, cols);
 
-  std::int64_t size = matx->size();
-#pragma omp parallel
-  {
-    auto tid = omp_get_thread_num();
-    auto tnum = omp_get_num_threads();
+  if (header.mEndian != MatxHeader::native_endian())
+    matx_byteswap(matx->data(), matx->size());
+}
 
-    auto begin = size * tid / tnum;
-    auto tsize = size * (tid + 1) / tnum - begin;
+/**
+ * @brief 从按列存储的二进制文件中加载第 begin 列起的 cols 列，有分块表时按块
+ * 直接定位。
+ *
+ * @param path 文件路径
+ */
+template<typename _Scalar>
+void
+matx_load_bin(BasicDataSet<_Scalar>* matx,
+              const char* path,
+              std::uint64_t begin,
+              std::uint64_t cols,
+              const MatxIO& io = {})
+{
+  MatxHeader header;
+  std::vector<MatxChunk> chunks;
+  CFile64::Closers files;
+  auto file = matx_open(path, io, &header, &chunks, &files);
+  if (!header.holds<_Scalar>())
+    throw err::Lit("mismatched matx dtype.");
+  if (header.mLayout != MatxHeader::Layout::kColMajor)
+    throw err::Lit("column range of row-major matx.");
+  if (begin > header.mCols || cols > header.mCols - begin)
+    throw err::Lit("column range out of matx.");
 
-    CFile64 file(path, "rb");
-    CFile64::Closer closer(file);
+  matx->resize(header.mRows, cols);
+  matx_read_outer(file, header, chunks, begin, begin + cols, matx->data(), io);
 
-    file.seek(sizeof(std::uint32_t) * 2 + sizeof(_Scalar) * begin, SEEK_SET);
-    file.read(matx->data() + begin, sizeof(_Scalar), tsize);
-  }
+  if (header.mEndian != MatxHeader::native_endian())
+    matx_byteswap(matx->data(), matx->size());
 }
 
 } // namespace Lib
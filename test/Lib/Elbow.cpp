@@ -0,0 +1,70 @@
+#include "util.hpp"
+
+#include <Lib/Elbow.hpp>
+#include <omp.h>
+
+using namespace Lib;
+
+//==============================================================================
+// 功能性测试
+//==============================================================================
+
+BOOST_AUTO_TEST_SUITE(functionality)
+
+BOOST_AUTO_TEST_CASE(tasks)
+{
+  DataSet data = DataSet::Random(4, 3000);
+  omp_set_num_threads(4);
+
+  Catalog cata[2];
+  MseHistory mseHist[2];
+  std::size_t ansIndex[2];
+  for (int i = 0; i < 2; ++i) {
+    Elbow elbow;
+    elbow.get_kmeans().mSeed = 42;
+    elbow.mTaskThreshold = i == 0 ? 0 : data.cols() + 1;
+    elbow(data, &cata[i], &mseHist[i], &ansIndex[i], 2, 12);
+  }
+
+  BOOST_TEST(mseHist[0].size() == 11);
+  BOOST_TEST((mseHist[0] == mseHist[1]));
+  BOOST_TEST(ansIndex[0] == ansIndex[1]);
+  BOOST_TEST((cata[0] == cata[1]));
+}
+
+BOOST_AUTO_TEST_CASE(f64)
+{
+  F64DataSet data = F64DataSet::Random(3, 3000);
+
+  Elbow elbow;
+  elbow.mWarmStart = true;
+  elbow.get_kmeans().mSeed = 42;
+
+  Catalog cata;
+  F64MseHistory mseHist;
+  std::size_t ansIndex;
+  elbow(data, &cata, &mseHist, &ansIndex, 2, 8);
+
+  BOOST_TEST(mseHist.size() == 7);
+  BOOST_TEST(ansIndex < mseHist.size());
+  BOOST_TEST(cata.size() == data.cols());
+  BOOST_TEST(mseHist.back().second < mseHist.front().second);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+//==============================================================================
+// 稳定性测试
+//==============================================================================
+
+BOOST_AUTO_TEST_SUITE(stablity)
+
+BOOST_AUTO_TEST_SUITE_END()
+
+//==============================================================================
+// 健壮性测试
+//==============================================================================
+
+BOOST_AUTO_TEST_SUITE(robustness)
+
+BOOST_AUTO_TEST_SUITE_END()
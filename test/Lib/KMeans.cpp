@@ -1,6 +1,8 @@
 #include "util.hpp"
 
 #include <Lib/KMeans.hpp>
+#include <Lib/WarmStart.hpp>
+#include <omp.h>
 
 using namespace Lib;
 
@@ -19,6 +21,137 @@ BOOST_AUTO_TEST_CASE(case0)
   BOOST_TEST(true);
 }
 
+BOOST_AUTO_TEST_CASE(hamerly)
+{
+  auto data = genrand::make_blobs(8, 5000, 16);
+
+  KMeans lloyd, hamerly;
+  lloyd.mSeed = hamerly.mSeed = 42;
+  hamerly.mEngine = KMeans::Engine::kHamerly;
+
+  Catalog cata1, cata2;
+  double mse1, mse2;
+  lloyd(data, 16, &cata1, &mse1);
+  hamerly(data, 16, &cata2, &mse2);
+
+  BOOST_TEST((cata1 == cata2));
+  BOOST_TEST(mse1 == mse2, boost::test_tools::tolerance(1e-6));
+}
+
+BOOST_AUTO_TEST_CASE(gemm)
+{
+  auto data = genrand::make_blobs(40, 5000, 100);
+
+  KMeans lloyd, gemm;
+  lloyd.mSeed = gemm.mSeed = 42;
+  gemm.mEngine = KMeans::Engine::kGemm;
+
+  Catalog cata1, cata2;
+  double mse1, mse2;
+  lloyd(data, 100, &cata1, &mse1);
+  gemm(data, 100, &cata2, &mse2);
+
+  BOOST_TEST((cata1 == cata2));
+  BOOST_TEST(mse1 == mse2, boost::test_tools::tolerance(1e-6));
+}
+
+BOOST_AUTO_TEST_CASE(mini_batch)
+{
+  auto data = genrand::make_blobs(8, 100000, 16);
+
+  KMeans lloyd, batch;
+  lloyd.mSeed = batch.mSeed = 42;
+  lloyd.mInit = batch.mInit = KMeans::Init::kPlusPlus;
+  batch.mEngine = KMeans::Engine::kMiniBatch;
+
+  Catalog cata1, cata2;
+  double mse1, mse2;
+  lloyd(data, 16, &cata1, &mse1);
+  batch(data, 16, &cata2, &mse2);
+
+  BOOST_TEST(cata2.size() == data.cols());
+  BOOST_TEST(mse2 == mse1, boost::test_tools::tolerance(0.05));
+}
+
+BOOST_AUTO_TEST_CASE(fixed_dims)
+{
+  for (int dims : { 2, 3, 8, 16 }) {
+    auto data = genrand::make_blobs(dims, 20000, 8);
+
+    // 多一行的矩阵取前 dims 行，各列不连续，只能走动态维数的路径
+    DataSet padded(dims + 1, data.cols());
+    padded.topRows(dims) = data;
+    DataView strided = padded.topRows(dims);
+
+    for (auto engine : { KMeans::Engine::kLloyd, KMeans::Engine::kHamerly }) {
+      KMeans kmeans;
+      kmeans.mSeed = 42;
+      kmeans.mEngine = engine;
+
+      Catalog cata1, cata2;
+      double mse1, mse2;
+      kmeans(data, 8, &cata1, &mse1);
+      kmeans(strided, 8, &cata2, &mse2);
+
+      // 两条路径的求和顺序不同，只允许极少数距离相近的点分类不同
+      auto diff = (cata1.array() != cata2.array()).count();
+      BOOST_TEST(diff <= data.cols() / 1000);
+      BOOST_TEST(mse1 == mse2, boost::test_tools::tolerance(1e-4));
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(f64)
+{
+  auto data = genrand::make_blobs(5, 20000, 8);
+  F64DataSet data64 = data.cast<double>();
+
+  for (auto engine : { KMeans::Engine::kLloyd,
+                       KMeans::Engine::kHamerly,
+                       KMeans::Engine::kGemm }) {
+    KMeans kmeans;
+    kmeans.mSeed = 42;
+    kmeans.mEngine = engine;
+
+    Catalog cata1, cata2;
+    double mse1, mse2;
+    F64DataSet centers;
+    kmeans(data, 8, &cata1, &mse1);
+    kmeans(data64, 8, &cata2, &mse2, &centers);
+
+    BOOST_TEST(centers.cols() == 8);
+    BOOST_TEST(mse1 == mse2, boost::test_tools::tolerance(1e-4));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(warm_start)
+{
+  auto data = genrand::make_blobs(8, 20000, 16);
+
+  KMeans kmeans;
+  kmeans.mSeed = 42;
+  kmeans.mInit = KMeans::Init::kPlusPlus;
+
+  Catalog cata;
+  double mse1, mse2;
+  DataSet centers;
+  kmeans(data, 16, &cata, &mse1, &centers);
+  BOOST_TEST(centers.cols() == 16);
+
+  // 从收敛的中心点开始，误差不应变大
+  kmeans(data, &centers, &cata, &mse2);
+  BOOST_TEST(mse2 <= mse1 * 1.001);
+
+  WarmStart warm;
+  BOOST_TEST(!warm.seed(16, &centers));
+  warm.record(data, centers, cata);
+  for (int k : { 4, 16, 24 }) {
+    BOOST_TEST(warm.seed(k, &centers));
+    BOOST_TEST(centers.cols() == k);
+    BOOST_TEST(centers.rows() == data.rows());
+  }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 //==============================================================================
@@ -27,6 +160,29 @@ BOOST_AUTO_TEST_SUITE_END()
 
 BOOST_AUTO_TEST_SUITE(stablity)
 
+BOOST_AUTO_TEST_CASE(thread_count)
+{
+  auto data = genrand::make_blobs(8, 50000, 16);
+
+  for (auto init : { KMeans::Init::kStratified,
+                     KMeans::Init::kPlusPlus,
+                     KMeans::Init::kParallel }) {
+    Catalog cata[2];
+    double mse[2];
+    for (int i = 0; i < 2; ++i) {
+      omp_set_num_threads(i == 0 ? 1 : 4);
+      KMeans kmeans;
+      kmeans.mSeed = 42;
+      kmeans.mInit = init;
+      kmeans(data, 16, &cata[i], &mse[i]);
+    }
+    omp_set_num_threads(omp_get_num_procs());
+
+    BOOST_TEST((cata[0] == cata[1]));
+    BOOST_TEST(mse[0] == mse[1], boost::test_tools::tolerance(1e-6));
+  }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 //==============================================================================
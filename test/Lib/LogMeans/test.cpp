@@ -0,0 +1,51 @@
+#include "util.hpp"
+
+#include <Lib/LogMeans.hpp>
+#include <omp.h>
+
+using namespace Lib;
+
+//==============================================================================
+// 功能性测试
+//==============================================================================
+
+BOOST_AUTO_TEST_SUITE(functionality)
+
+BOOST_AUTO_TEST_CASE(concurrency)
+{
+  auto data = genrand::make_blobs(4, 5000, 12, 20);
+  omp_set_num_threads(4);
+
+  std::size_t ansK[2];
+  for (int i = 0; i < 2; ++i) {
+    LogMeans logmeans;
+    logmeans.get_kmeans().mSeed = 42;
+    logmeans.mConcurrency = i == 0 ? 1 : 4;
+
+    Catalog cata;
+    MseHistory mseHist;
+    std::size_t ansIndex;
+    logmeans(data, &cata, &mseHist, &ansIndex, 2, 40);
+    ansK[i] = mseHist[ansIndex].first;
+  }
+
+  BOOST_TEST(ansK[0] == ansK[1]);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+//==============================================================================
+// 稳定性测试
+//==============================================================================
+
+BOOST_AUTO_TEST_SUITE(stablity)
+
+BOOST_AUTO_TEST_SUITE_END()
+
+//==============================================================================
+// 健壮性测试
+//==============================================================================
+
+BOOST_AUTO_TEST_SUITE(robustness)
+
+BOOST_AUTO_TEST_SUITE_END()
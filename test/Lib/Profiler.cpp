@@ -0,0 +1,214 @@
+#include "util.hpp"
+
+#include <Lib/Profiler.hpp>
+#include <boost/json.hpp>
+#include <cstring>
+#include <omp.h>
+
+using namespace Lib;
+
+//==============================================================================
+// 功能性测试
+//==============================================================================
+
+BOOST_AUTO_TEST_SUITE(functionality)
+
+BOOST_AUTO_TEST_CASE(multithread)
+{
+  constexpr int kTimes = 1000;
+
+  Profiler prof;
+  auto copy = prof; // 浅拷贝共享计时序列
+  auto& first = prof.time("first");
+  int threads = 0;
+
+#pragma omp parallel
+  {
+#pragma omp single
+    threads = omp_get_num_threads();
+    for (int i = 0; i < kTimes; ++i)
+      copy.time("iter");
+  }
+
+  std::size_t count = 0;
+  auto last = prof.initial();
+  for (auto&& i : prof) {
+    BOOST_TEST((i.mTime >= last)); // 按计时点的先后顺序
+    last = i.mTime;
+    ++count;
+  }
+  BOOST_TEST(count == 1 + threads * kTimes);
+  BOOST_TEST(&*prof.begin() == &first); // 条目的地址不变
+}
+
+BOOST_AUTO_TEST_CASE(json)
+{
+  Profiler prof;
+  {
+    Profiler::Scope scope(prof, "scope");
+    prof.time("info", new Profiler::StrInfo("hello"), true);
+  }
+
+  auto json = prof.to_json();
+  std::set<std::string> tags;
+  auto prof2 = Profiler::from_json(json, tags);
+  BOOST_TEST((prof2.to_json() == json));
+
+  auto& arr = json.as_array();
+  BOOST_TEST(arr.size() == 3);
+  BOOST_TEST((arr.at(0).as_array().at(2) == "ENTER"));
+  BOOST_TEST((arr.at(1).as_array().at(2) == "hello"));
+}
+
+BOOST_AUTO_TEST_CASE(inline_info)
+{
+  Profiler prof;
+  auto& iter = prof.time("iter", Profiler::Inline("MSE[{}]={}", 3, 0.5));
+  BOOST_TEST(iter.info() == "MSE[3]=" + std::to_string(0.5));
+  BOOST_TEST(iter.mInfo == nullptr);
+
+  auto& text = prof.time("text", "static");
+  BOOST_TEST(text.info() == "static");
+  BOOST_TEST(!prof.time("none").has_info());
+
+  // 数值不足时保留多余的 "{}"
+  auto& extra = prof.time("extra", Profiler::Inline("{}-{}", -1));
+  BOOST_TEST(extra.info() == "-1-{}");
+
+  std::ostringstream out;
+  out << prof;
+  BOOST_TEST(out.str().find("iter [") != std::string::npos);
+  BOOST_TEST(out.str().find(" : MSE[3]=") != std::string::npos);
+}
+
+BOOST_AUTO_TEST_CASE(trace)
+{
+  Profiler prof;
+  int threads = 0;
+
+#pragma omp parallel
+  {
+#pragma omp single
+    threads = omp_get_num_threads();
+    Profiler::Scope outer(prof, "outer");
+    {
+      Profiler::Scope inner(prof, "inner");
+      prof.time("iter", Profiler::Inline("MSE[{}]={}", 1, 0.5));
+    }
+  }
+
+  // 每个线程各自从 0 层开始嵌套
+  std::set<std::uint32_t> tids;
+  for (auto&& i : prof) {
+    tids.insert(i.mThread);
+    if (!std::strcmp(i.mTag, "outer"))
+      BOOST_TEST(i.mDepth == 0);
+    else if (!std::strcmp(i.mTag, "inner"))
+      BOOST_TEST(i.mDepth == 1);
+    else
+      BOOST_TEST(i.mDepth == 2);
+  }
+  BOOST_TEST(tids.size() == threads);
+
+  auto json = prof.to_trace();
+  std::map<std::string, int> phases;
+  for (auto&& i : json.as_object().at("traceEvents").as_array()) {
+    const auto& event = i.as_object();
+    ++phases[event.at("ph").as_string().c_str()];
+    if (event.at("ph") == "C")
+      BOOST_TEST(event.at("args").as_object().at("value").as_double() == 0.5);
+  }
+  BOOST_TEST(phases["B"] == 2 * threads);
+  BOOST_TEST(phases["E"] == 2 * threads);
+  BOOST_TEST(phases["i"] == threads);
+  BOOST_TEST(phases["C"] == threads);
+  BOOST_TEST(phases["M"] == threads);
+}
+
+BOOST_AUTO_TEST_CASE(counters)
+{
+  Profiler prof;
+  bool enabled = prof.enable_counters(); // 不允许性能事件时只计时
+  BOOST_TEST(prof.counting() == enabled);
+  {
+    Profiler::Scope scope(prof, "scope");
+    volatile double sum = 0;
+    for (int i = 0; i < 100000; ++i)
+      sum = sum + i;
+  }
+
+  auto json = prof.to_json();
+  const auto& leave = json.as_array().at(1).as_array();
+  BOOST_TEST(leave.size() == (enabled ? 4 : 3));
+  if (enabled) {
+    const auto& counters = leave.at(3).as_object();
+    auto it = counters.find("instructions");
+    if (it != counters.end())
+      BOOST_TEST(it->value().to_number<std::uint64_t>() >= 100000);
+  }
+
+  std::set<std::string> tags;
+  BOOST_TEST((Profiler::from_json(json, tags).to_json() == json));
+
+  BOOST_TEST(!prof.enable_counters(false));
+  BOOST_TEST(!prof.counting());
+}
+
+BOOST_AUTO_TEST_CASE(histogram)
+{
+  Profiler::Histogram hist;
+  for (std::uint64_t i = 1; i <= 100000; ++i)
+    hist.record(i);
+  BOOST_TEST(hist.count() == 100000);
+  BOOST_TEST(hist.min() == 1);
+  BOOST_TEST(hist.max() == 100000);
+
+  // 相对误差不超过一个桶的宽度
+  for (double q : { 0.5, 0.9, 0.99 }) {
+    double p = hist.percentile(q), expected = q * 100000;
+    BOOST_TEST(std::abs(p - expected) <= expected / hist.kSubs);
+  }
+  BOOST_TEST(hist.percentile(0) == 1);
+  BOOST_TEST(hist.percentile(1) == 100000);
+}
+
+BOOST_AUTO_TEST_CASE(aggregate)
+{
+  constexpr int kTimes = 100;
+
+  Profiler prof(Profiler::Mode::kAggregate);
+  int threads = 0;
+
+#pragma omp parallel
+  {
+#pragma omp single
+    threads = omp_get_num_threads();
+    for (int i = 0; i < kTimes; ++i) {
+      Profiler::Scope scope(prof, "scope");
+      prof.time("step", Profiler::Inline("{}", i));
+    }
+  }
+
+  BOOST_TEST((prof.begin() == prof.end())); // 不保留记录
+
+  auto hists = prof.histograms();
+  BOOST_TEST(hists.size() == 2);
+  BOOST_TEST(hists.at("scope").count() == threads * kTimes);
+  BOOST_TEST(hists.at("step").count() == threads * kTimes);
+
+  const auto& scope = hists.at("scope");
+  BOOST_TEST(scope.min() <= scope.percentile(0.5));
+  BOOST_TEST(scope.percentile(0.5) <= scope.percentile(0.9));
+  BOOST_TEST(scope.percentile(0.99) <= scope.max());
+
+  auto json = prof.to_json();
+  const auto& step = json.as_object().at("step").as_object();
+  BOOST_TEST(step.at("count").to_number<int>() == threads * kTimes);
+
+  std::ostringstream out;
+  out << prof;
+  BOOST_TEST(out.str().find("scope [" + std::to_string(threads * kTimes)) !=
+             std::string::npos);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,132 @@
+#include "util.hpp"
+
+#include <Lib/Elbow.hpp>
+#include <Lib/KMeans.hpp>
+#include <Lib/LogMeans.hpp>
+#include <Lib/Quantized.hpp>
+
+using namespace Lib;
+
+/**
+ * @brief 解码全部数据。
+ */
+template<typename Code>
+static DataSet
+decode(const Quantized<Code>& q)
+{
+  DataSet ret;
+  q.decode(0, q.cols(), &ret);
+  return ret;
+}
+
+//==============================================================================
+// 功能性测试
+//==============================================================================
+
+BOOST_AUTO_TEST_SUITE(functionality)
+
+BOOST_AUTO_TEST_CASE(precision)
+{
+  auto data = genrand::make_blobs(6, 2000, 4);
+  data.row(5).setConstant(3); // 常数维
+
+  // int8 的误差不超过量化步长的一半，浮点编码的误差按其有效位数计
+  I8DataSet i8(data);
+  Eigen::ArrayXXf err = (decode(i8) - data).cwiseAbs();
+  for (int d = 0; d < data.rows(); ++d)
+    BOOST_TEST(err.row(d).maxCoeff() <= i8.scale()(d) * 0.501f);
+
+  F16DataSet f16(data);
+  BOOST_TEST(decode(f16).isApprox(data, 1e-3f));
+
+  BF16DataSet bf16(data);
+  BOOST_TEST(decode(bf16).isApprox(data, 1e-2f));
+}
+
+BOOST_AUTO_TEST_CASE(io)
+{
+  auto data = genrand::make_blobs(5, 300, 3);
+  matx_dump_bin(data, "quant_f32");
+  BOOST_TEST((MatxHeader::peek("quant_f32").mDType == MatxHeader::DType::kF32));
+  BOOST_TEST(MatxHeader::peek("quant_f32").mCols == 300);
+
+  I8DataSet i8(data), i8Loaded;
+  i8.dump_bin("quant_i8");
+  BOOST_TEST((MatxHeader::peek("quant_i8").mDType == MatxHeader::DType::kI8));
+  i8Loaded.load_bin("quant_i8");
+  BOOST_TEST((i8Loaded.codes() == i8.codes()));
+  BOOST_TEST((i8Loaded.scale() == i8.scale()));
+  BOOST_TEST((i8Loaded.offset() == i8.offset()));
+
+  BF16DataSet bf16(data), bf16Loaded;
+  bf16.dump_bin("quant_bf16");
+  bf16Loaded.load_bin("quant_bf16");
+  BOOST_TEST((decode(bf16Loaded) == decode(bf16)));
+}
+
+BOOST_AUTO_TEST_CASE(kmeans)
+{
+  auto data = genrand::make_blobs(8, 20000, 16);
+  I8DataSet i8(data);
+  auto decoded = decode(i8);
+
+  // 各引擎的最终误差都是在解码后的数据上精确计算的；不与 float 版比较误差，
+  // 两次独立的聚类可能停在不同的局部最优
+  KMeans kmeans;
+  kmeans.mSeed = 42;
+  for (auto engine : { KMeans::Engine::kLloyd,
+                       KMeans::Engine::kHamerly,
+                       KMeans::Engine::kGemm }) {
+    kmeans.mEngine = engine;
+    Catalog cata;
+    double mse;
+    DataSet centers;
+    kmeans(i8, 16, &cata, &mse, &centers);
+    BOOST_TEST(cata.size() == data.cols());
+
+    double exact = 0;
+    for (int i = 0; i < decoded.cols(); ++i)
+      exact += (decoded.col(i) - centers.col(cata(i))).norm();
+    BOOST_TEST(mse == exact / decoded.cols(),
+               boost::test_tools::tolerance(1e-4));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(search)
+{
+  auto data = genrand::make_blobs(4, 5000, 8);
+  F16DataSet f16(data);
+
+  Catalog cata;
+  MseHistory mseHist;
+  std::size_t ansIndex;
+
+  Elbow elbow;
+  elbow.mWarmStart = true;
+  elbow(f16, &cata, &mseHist, &ansIndex, 2, 12);
+  BOOST_TEST(mseHist.size() == 11);
+  BOOST_TEST(cata.size() == data.cols());
+
+  LogMeans logMeans;
+  logMeans(f16, &cata, &mseHist, &ansIndex, 2, 30);
+  BOOST_TEST(ansIndex < mseHist.size());
+  BOOST_TEST(cata.size() == data.cols());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+//==============================================================================
+// 鲁棒性测试
+//==============================================================================
+
+BOOST_AUTO_TEST_SUITE(robustness)
+
+BOOST_AUTO_TEST_CASE(dtype)
+{
+  I8DataSet(DataSet(DataSet::Random(3, 10))).dump_bin("quant_i8");
+
+  F16DataSet f16;
+  BOOST_CHECK_THROW(f16.load_bin("quant_i8"), err::Lit);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,102 @@
+#include "util.hpp"
+
+#include <Lib/ReportSink.hpp>
+#include <Lib/err.hpp>
+#include <omp.h>
+#include <sstream>
+
+using namespace Lib;
+
+//==============================================================================
+// 功能性测试
+//==============================================================================
+
+BOOST_AUTO_TEST_SUITE(functionality)
+
+BOOST_AUTO_TEST_CASE(filter)
+{
+  BOOST_TEST(TagFilter().all());
+  BOOST_TEST(TagFilter(nullptr).all());
+  BOOST_TEST(TagFilter("").all());
+
+  TagFilter filter("KMeans-iter,LogMeans*");
+  BOOST_TEST(!filter.all());
+  BOOST_TEST(filter.match("KMeans-iter"));
+  BOOST_TEST(!filter.match("KMeans-init"));
+  BOOST_TEST(filter.match("LogMeans"));
+  BOOST_TEST(filter.match("LogMeans-iterstart"));
+  BOOST_TEST(!filter.match("Elbow"));
+
+  // 简单的正则表达式写法
+  TagFilter re("KMeans\\|Elbow.*");
+  BOOST_TEST(re.match("KMeans"));
+  BOOST_TEST(!re.match("KMeans-iter"));
+  BOOST_TEST(re.match("Elbow-iter"));
+
+  // 其他正则表达式写法不能悄悄地变成精确匹配
+  for (auto spec : { ".*iter", "KMeans-.*-iter", "[AB]", "A+", "(A)" })
+    BOOST_CHECK_THROW(TagFilter(spec).all(), err::Lit);
+
+  // 缓存以过滤器区分
+  BOOST_TEST(filter.match("Elbow") == false);
+  BOOST_TEST(re.match("Elbow") == true);
+}
+
+BOOST_AUTO_TEST_CASE(multithread)
+{
+  constexpr int kTimes = 100;
+
+  std::ostringstream out;
+  std::uint64_t pushed = 0, dropped = 0;
+  int threads = 0;
+  {
+    ReportSink sink(out, TagFilter("iter"), 1 << 16);
+    Profiler prof;
+
+#pragma omp parallel reduction(+ : pushed)
+    {
+#pragma omp single
+      threads = omp_get_num_threads();
+      for (int i = 0; i < kTimes; ++i) {
+        Profiler::Scope scope(prof, "scope");
+        pushed += sink.push(
+          prof.time("iter", Profiler::Inline("MSE[{}]={}", i, 0.5)),
+          prof.initial());
+        sink.push(prof.time("skip"), prof.initial());
+      }
+    }
+
+    dropped = sink.dropped();
+  } // 析构时输出剩余的记录
+
+  BOOST_TEST(pushed + dropped == threads * kTimes);
+
+  std::istringstream in(out.str());
+  std::uint64_t lines = 0;
+  for (std::string line; std::getline(in, line); ++lines) {
+    BOOST_TEST(line.find(" iter MSE[") != std::string::npos);
+    BOOST_TEST(line.find("skip") == std::string::npos);
+  }
+  BOOST_TEST(lines == pushed);
+}
+
+BOOST_AUTO_TEST_CASE(scope_info)
+{
+  std::ostringstream out;
+  {
+    ReportSink sink(out);
+    Profiler prof;
+    {
+      Profiler::Scope scope(prof, "scope");
+      sink.push(*prof.begin(), prof.initial());
+      sink.push(prof.time("text", new Profiler::StrInfo("hello"), true),
+                prof.initial());
+    }
+  }
+
+  auto text = out.str();
+  BOOST_TEST(text.find(" scope ENTER\n") != std::string::npos);
+  BOOST_TEST(text.find(" text hello\n") != std::string::npos);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,98 @@
+#include "util.hpp"
+
+#include <Lib/KMeans.hpp>
+#include <Lib/LogMeans.hpp>
+#include <Lib/StreamKMeans.hpp>
+
+using namespace Lib;
+
+//==============================================================================
+// 功能性测试
+//==============================================================================
+
+BOOST_AUTO_TEST_SUITE(functionality)
+
+BOOST_AUTO_TEST_CASE(chunks)
+{
+  auto data = genrand::make_blobs(8, 20000, 16);
+  matx_dump_bin(data, "stream_data");
+
+  // 块大小只影响累加顺序，不影响结果
+  StreamKMeans whole, chunked;
+  whole.mSeed = chunked.mSeed = 42;
+  whole.mChunkCols = data.cols();
+  chunked.mChunkCols = 3000;
+
+  DataSet ctrs1, ctrs2;
+  double mse1, mse2;
+  whole("stream_data", 16, "stream_cata1", &mse1, &ctrs1);
+  chunked("stream_data", 16, "stream_cata2", &mse2, &ctrs2);
+
+  Catalog cata1, cata2;
+  matx_load_bin(&cata1, "stream_cata1");
+  matx_load_bin(&cata2, "stream_cata2");
+  BOOST_TEST(cata1.size() == data.cols());
+  BOOST_TEST((cata1 == cata2));
+  BOOST_TEST(mse1 == mse2, boost::test_tools::tolerance(1e-5));
+  BOOST_TEST(ctrs1.isApprox(ctrs2, 1e-5f));
+
+  // 与内存版的误差相当
+  KMeans kmeans;
+  kmeans.mSeed = 42;
+  Catalog cata;
+  double mse;
+  kmeans(data, 16, &cata, &mse);
+  BOOST_TEST(mse2 == mse, boost::test_tools::tolerance(0.1));
+}
+
+BOOST_AUTO_TEST_CASE(log_means)
+{
+  auto data = genrand::make_blobs(4, 20000, 12);
+  matx_dump_bin(data, "stream_data");
+
+  LogMeans logMeans;
+  logMeans.get_stream_kmeans().mSeed = 42;
+  logMeans.get_stream_kmeans().mChunkCols = 4096;
+
+  MseHistory hist;
+  std::size_t ans;
+  logMeans("stream_data", "stream_cata", &hist, &ans, 2, 40);
+
+  BOOST_TEST(hist.size() > 2);
+  BOOST_TEST(hist[0].first == 2);
+  BOOST_TEST(hist[1].first == 40);
+  BOOST_TEST(ans < hist.size());
+
+  // 每个聚类数的误差与单独运行 StreamKMeans 一致
+  StreamKMeans kmeans;
+  kmeans.mSeed = 42;
+  kmeans.mChunkCols = 4096;
+  double mse;
+  kmeans("stream_data", hist[ans].first, nullptr, &mse);
+  BOOST_TEST(mse == hist[ans].second, boost::test_tools::tolerance(1e-6));
+
+  Catalog cata;
+  matx_load_bin(&cata, "stream_cata");
+  BOOST_TEST(cata.size() == data.cols());
+  BOOST_TEST(cata.maxCoeff() < hist[ans].first); // 最终聚类数的结果
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+//==============================================================================
+// 鲁棒性测试
+//==============================================================================
+
+BOOST_AUTO_TEST_SUITE(robustness)
+
+BOOST_AUTO_TEST_CASE(engine)
+{
+  matx_dump_bin(DataSet(DataSet::Random(2, 100)), "stream_data");
+
+  StreamKMeans kmeans;
+  kmeans.mEngine = KMeans::Engine::kHamerly;
+  double mse;
+  BOOST_CHECK_THROW(kmeans("stream_data", 4, nullptr, &mse), err::Lit);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -1,5 +1,9 @@
 #include "util.hpp"
+#include <Lib/CsvFile.hpp>
+#include <Lib/MappedDataSet.hpp>
+#include <Lib/MatxParser.hpp>
 #include <Lib/lib.hpp>
+#include <fstream>
 
 using namespace Lib;
 
@@ -19,6 +23,43 @@ BOOST_AUTO_TEST_CASE(DataSet_io_json)
   BOOST_TEST((ds == ds2));
 }
 
+BOOST_AUTO_TEST_CASE(DataSet_io_stream_json)
+{
+  DataSet ds(7, 3001);
+  for (auto *p = ds.data(), *end = ds.data() + ds.size(); p != end; ++p)
+    *p = genrand::norm();
+  bj::object obj;
+  obj["dataset"] = matx_to_json(ds);
+  obj["kmin"] = 2;
+  auto text = bj::serialize(obj);
+
+  MatxParser parser;
+  for (std::size_t bytes : { std::size_t(-1), std::size_t(0) }) {
+    parser.mParallelBytes = bytes; // 逐个解析与并行解析
+    DataSet ds2;
+    auto val = parser(text, "dataset", &ds2);
+    BOOST_TEST((ds == ds2));
+    BOOST_TEST(val.as_object().at("kmin").as_int64() == 2);
+    BOOST_TEST(val.as_object().at("dataset").is_object());
+  }
+
+  // rows 与 cols 在 data 之后，带注释和末尾逗号
+  parser.mOptions.allow_comments = true;
+  parser.mOptions.allow_trailing_commas = true;
+  text = R"({"dataset": {"data": [1, 2.5, -3e1, 4, 5, 6,], // 按列
+                         "cols": 2, "rows": 3}, "cata": "x"})";
+  for (std::size_t bytes : { std::size_t(-1), std::size_t(0) }) {
+    parser.mParallelBytes = bytes;
+    DataSet ds2;
+    auto val = parser(text, "dataset", &ds2);
+    BOOST_TEST(ds2.rows() == 3);
+    BOOST_TEST(ds2.cols() == 2);
+    BOOST_TEST(ds2(2, 0) == -30);
+    BOOST_TEST(ds2(2, 1) == 6);
+    BOOST_TEST(val.as_object().at("cata").as_string() == "x");
+  }
+}
+
 BOOST_AUTO_TEST_CASE(DataSet_io_bin)
 {
   DataSet ds(32, 32);
@@ -31,6 +72,209 @@ BOOST_AUTO_TEST_CASE(DataSet_io_bin)
   BOOST_TEST((ds == ds2));
 }
 
+BOOST_AUTO_TEST_CASE(DataSet_io_mmap)
+{
+  DataSet ds(16, 1000);
+  for (auto *p = ds.data(), *end = ds.data() + ds.size(); p != end; ++p)
+    *p = genrand::norm();
+  matx_dump_bin(ds, "dataset_mmap");
+
+  MappedDataSet mds("dataset_mmap");
+  mds.advise(MappedDataSet::Advice::kSequential);
+  BOOST_TEST(mds.rows() == ds.rows());
+  BOOST_TEST(mds.cols() == ds.cols());
+  BOOST_TEST((mds.map() == ds));
+
+  DataView view = mds;
+  BOOST_TEST(view.data() == mds.map().data()); // 没有发生拷贝
+}
+
+BOOST_AUTO_TEST_CASE(DataSet_io_csv)
+{
+  F64DataSet ds(5, 20011);
+  for (auto *p = ds.data(), *end = ds.data() + ds.size(); p != end; ++p)
+    *p = genrand::norm();
+  {
+    std::ofstream fout("dataset.csv");
+    fout << std::setprecision(17);
+    for (Eigen::Index j = 0; j < ds.cols(); ++j) {
+      for (Eigen::Index i = 0; i < ds.rows(); ++i)
+        fout << (i ? ", " : "") << ds(i, j);
+      fout << (j % 1000 ? "\n" : "\r\n\n"); // 夹杂空行和 CRLF
+    }
+  }
+
+  CsvFile csv("dataset.csv");
+  csv.mChunkBytes = 4096; // 切为大量小段
+  BOOST_TEST(csv.dims() == ds.rows());
+
+  F64DataSet ds2;
+  csv.load(&ds2);
+  BOOST_TEST((ds == ds2));
+
+  csv.dump_bin<double>("dataset_csv");
+  F64DataSet ds3;
+  matx_load_bin(&ds3, "dataset_csv");
+  BOOST_TEST((ds == ds3));
+
+  DataSet ds4;
+  csv.load(&ds4);
+  BOOST_TEST((ds.cast<float>() == ds4));
+}
+
+BOOST_AUTO_TEST_CASE(F64DataSet_io_bin)
+{
+  F64DataSet ds(8, 500);
+  for (auto *p = ds.data(), *end = ds.data() + ds.size(); p != end; ++p)
+    *p = genrand::norm();
+  matx_dump_bin(ds, "dataset_f64");
+  BOOST_TEST((MatxHeader::peek("dataset_f64").mDType ==
+              MatxHeader::DType::kF64));
+
+  F64DataSet ds2;
+  matx_load_bin(&ds2, "dataset_f64");
+  BOOST_TEST((ds == ds2));
+
+  F64MappedDataSet mds("dataset_f64");
+  BOOST_TEST((mds.map() == ds));
+
+  // 旧格式没有数据类型，按文件大小推断元素宽度
+  {
+    CFile64 file("dataset_f64_v0", "wb");
+    CFile64::Closer closer(file);
+    file << std::uint32_t(ds.rows()) << std::uint32_t(ds.cols());
+    file.write(ds.data(), sizeof(double), ds.size());
+  }
+  auto header = MatxHeader::peek("dataset_f64_v0");
+  BOOST_TEST(header.mVersion == 0);
+  BOOST_TEST((header.mDType == MatxHeader::DType::kF64));
+  matx_load_bin(&ds2, "dataset_f64_v0");
+  BOOST_TEST((ds == ds2));
+}
+
+BOOST_AUTO_TEST_CASE(DataSet_io_chunked)
+{
+  // 超过 kChunkBytes，切为两块
+  DataSet ds(64, 70000);
+  for (auto *p = ds.data(), *end = ds.data() + ds.size(); p != end; ++p)
+    *p = genrand::norm();
+  matx_dump_bin(ds, "dataset_chunked");
+
+  auto header = MatxHeader::peek("dataset_chunked");
+  BOOST_TEST(header.mVersion == 2);
+  BOOST_TEST(header.mChunks == 2);
+  BOOST_TEST(header.offset() == MatxHeader::kAlign);
+
+  DataSet ds2;
+  matx_load_bin(&ds2, "dataset_chunked");
+  BOOST_TEST((ds == ds2));
+
+  // 跨越块边界的列范围
+  matx_load_bin(&ds2, "dataset_chunked", 65000, 1000);
+  BOOST_TEST((ds.middleCols(65000, 1000) == ds2));
+
+  MappedDataSet mds("dataset_chunked");
+  BOOST_TEST((mds.map() == ds));
+}
+
+BOOST_AUTO_TEST_CASE(DataSet_io_pread)
+{
+  DataSet ds(13, 5001);
+  for (auto *p = ds.data(), *end = ds.data() + ds.size(); p != end; ++p)
+    *p = genrand::norm();
+
+  // 请求很小，且数据总长不是块的整数倍
+  MatxIO io;
+  io.mRequestBytes = 3 * CFile64::kDirectAlign;
+  for (bool direct : { false, true }) {
+    io.mDirect = direct;
+    matx_dump_bin(ds, "dataset_pread", io);
+
+    DataSet ds2;
+    matx_load_bin(&ds2, "dataset_pread", io);
+    BOOST_TEST((ds == ds2));
+
+    matx_load_bin(&ds2, "dataset_pread", 777, 3333, io);
+    BOOST_TEST((ds.middleCols(777, 3333) == ds2));
+  }
+
+  CFile64 file("dataset_pread", "rb");
+  CFile64::Closer closer(file);
+  auto size = MatxHeader::peek("dataset_pread").offset() + 4 * ds.size();
+  std::vector<char> buf(100);
+  BOOST_TEST(file.pread(buf.data(), buf.size(), size - 10) == 10);
+  BOOST_TEST(file.pread(buf.data(), buf.size(), size) == 0);
+}
+
+BOOST_AUTO_TEST_CASE(DataSet_io_bin_v1)
+{
+  DataSet ds(5, 300);
+  for (auto *p = ds.data(), *end = ds.data() + ds.size(); p != end; ++p)
+    *p = genrand::norm();
+
+  // 版本 1 的文件头只到 mCols 为止
+  {
+    CFile64 file("dataset_v1", "wb");
+    CFile64::Closer closer(file);
+    file << MatxHeader::kMagic << std::uint16_t(1) << MatxHeader::DType::kF32
+         << std::uint8_t(0) << std::uint64_t(ds.rows())
+         << std::uint64_t(ds.cols());
+    file.write(ds.data(), sizeof(float), ds.size());
+  }
+  auto header = MatxHeader::peek("dataset_v1");
+  BOOST_TEST(header.mVersion == 1);
+  BOOST_TEST(header.offset() == 24);
+
+  DataSet ds2;
+  matx_load_bin(&ds2, "dataset_v1");
+  BOOST_TEST((ds == ds2));
+
+  MappedDataSet mds("dataset_v1");
+  BOOST_TEST((mds.map() == ds));
+}
+
+BOOST_AUTO_TEST_CASE(DataSet_io_bin_foreign)
+{
+  DataSet ds(3, 50);
+  for (auto *p = ds.data(), *end = ds.data() + ds.size(); p != end; ++p)
+    *p = genrand::norm();
+
+  // 按行存储、字节序与本机相反的文件
+  MatxHeader header;
+  header.mRows = ds.rows(), header.mCols = ds.cols();
+  header.mLayout = MatxHeader::Layout::kRowMajor;
+  header.mEndian = MatxHeader::native_endian() == MatxHeader::Endian::kLittle
+                     ? MatxHeader::Endian::kBig
+                     : MatxHeader::Endian::kLittle;
+  auto chunks = header.make_chunks(sizeof(float));
+  auto offset = header.mOffset;
+
+  matx_byteswap(&header.mMagic, 1);
+  matx_byteswap(&header.mVersion, 1);
+  matx_byteswap(&header.mRows, 2);
+  matx_byteswap(&header.mChunks, 1);
+  matx_byteswap(&header.mOffset, 1);
+  for (auto& chunk : chunks)
+    matx_byteswap(&chunk.mBegin, 2);
+
+  Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> rows =
+    ds;
+  matx_byteswap(rows.data(), rows.size());
+  {
+    CFile64 file("dataset_foreign", "wb");
+    CFile64::Closer closer(file);
+    file.write(&header, sizeof(header), 1);
+    file.write(chunks.data(), sizeof(MatxChunk), chunks.size());
+    file.seek(offset, SEEK_SET);
+    file.write(rows.data(), sizeof(float), rows.size());
+  }
+
+  DataSet ds2;
+  matx_load_bin(&ds2, "dataset_foreign");
+  BOOST_TEST((ds == ds2));
+  BOOST_CHECK_THROW(MappedDataSet("dataset_foreign"), Err);
+}
+
 BOOST_AUTO_TEST_CASE(Catalog_io_json)
 {
   Catalog ct(7);
@@ -69,4 +313,48 @@ BOOST_AUTO_TEST_SUITE_END()
 
 BOOST_AUTO_TEST_SUITE(robustness)
 
+BOOST_AUTO_TEST_CASE(mismatched_dtype)
+{
+  matx_dump_bin(DataSet(DataSet::Random(4, 10)), "dataset_f32");
+
+  F64DataSet ds;
+  BOOST_CHECK_THROW(matx_load_bin(&ds, "dataset_f32"), err::Lit);
+  BOOST_CHECK_THROW(F64MappedDataSet("dataset_f32"), err::Lit);
+}
+
+BOOST_AUTO_TEST_CASE(bad_csv)
+{
+  for (auto text : { "1,2\n3\n", "1,2\n3,4,5\n", "1,2\n3,x\n" }) {
+    std::ofstream("bad.csv") << text;
+    DataSet ds;
+    BOOST_CHECK_THROW(CsvFile("bad.csv").load(&ds), err::Lit);
+    BOOST_CHECK_THROW(CsvFile("bad.csv").dump_bin<float>("bad"), err::Lit);
+    BOOST_TEST(!std::ifstream("bad")); // 不留下没有文件头的输出
+  }
+}
+
+BOOST_AUTO_TEST_CASE(bad_stream_json)
+{
+  MatxParser parser;
+  for (std::size_t bytes : { std::size_t(-1), std::size_t(0) }) {
+    parser.mParallelBytes = bytes;
+    DataSet ds;
+    BOOST_CHECK_THROW(
+      parser(R"({"dataset": {"rows": 2, "cols": 2, "data": [1, 2, 3]}})",
+             "dataset",
+             &ds),
+      err::Lit);
+    BOOST_CHECK_THROW(
+      parser(R"({"dataset": {"rows": 1, "cols": 2, "data": [1, "2"]}})",
+             "dataset",
+             &ds),
+      err::Lit);
+    BOOST_CHECK_THROW(parser(R"({"dataset": {"rows": 1, "cols": 2, )"
+                             R"("data": [1, 2})",
+                             "dataset",
+                             &ds),
+                      Err);
+  }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -14,4 +14,22 @@ split(size_t n)
   return ret;
 }
 
+Eigen::MatrixXf
+make_blobs(int dims, int nums, int k, float scale)
+{
+  std::uniform_real_distribution<float> uniform(-scale, scale);
+  std::normal_distribution<float> noise;
+
+  Eigen::MatrixXf centers(dims, k);
+  for (Eigen::Index i = 0; i < centers.size(); ++i)
+    centers.data()[i] = uniform(gRand);
+
+  Eigen::MatrixXf data(dims, nums);
+  for (int i = 0; i < nums; ++i) {
+    for (int j = 0; j < dims; ++j)
+      data(j, i) = centers(j, i % k) + noise(gRand);
+  }
+  return data;
+}
+
 }
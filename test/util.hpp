@@ -3,6 +3,7 @@
 #include <boost/test/unit_test.hpp>
 
 #include "project.h"
+#include <Eigen/Dense>
 #include <chrono>
 #include <iomanip>
 #include <iostream>
@@ -93,10 +94,28 @@ index(std::size_t end)
   return std::uniform_int_distribution<std::size_t>(0, end - 1)(gRand);
 }
 
+/**
+ * @brief 生成整数类型 T 取值范围内的均匀随机数。
+ */
+template<typename T>
+inline T
+range()
+{
+  return std::uniform_int_distribution<T>(std::numeric_limits<T>::min(),
+                                          std::numeric_limits<T>::max())(gRand);
+}
+
 /**
  * @brief 生成期望将0~1均匀分成n+1份的随机分割点数列，返回的数列已按升序排序。
  */
 std::vector<double>
 split(std::size_t n);
 
+/**
+ * @brief 生成 k 个高斯团组成的 dims 维数据集，第 i 个点属于第 i % k 个团。
+ * 团中心在 [-scale, scale]^dims 中均匀分布，团内为标准正态噪声。
+ */
+Eigen::MatrixXf
+make_blobs(int dims, int nums, int k, float scale = 10);
+
 }